@@ -19,6 +19,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <arpa/inet.h>
 
 #include <confuse.h>
 #include <ev.h>
@@ -26,36 +29,169 @@
 #include "conf.h"
 
 extern void timeout_cb(EV_P_ ev_timer *w, int revents);
+extern void retry_cb(EV_P_ ev_timer *w, int revents);
 
 static cfg_t *config;
 
 
-static int validate_interface_config(cfg_t *cfg, cfg_opt_t *opt)
+#define DEFAULT_TIMEOUT  10     // seconds
+
+
+// libconfuse expands ${...} from the environment, so use a printf-style placeholder
+#define IFNAME_PLACEHOLDER  "%i"
+
+
+static bool is_interface_pattern(const char *title)
 {
-    int ret = CFG_SUCCESS;
+    return strpbrk(title, "*?[") != NULL;
+}
 
-    // get the last parsed interface section
-    cfg_t *sec = cfg_opt_getnsec(opt, cfg_opt_size(opt) - 1);
 
-    // all sub-options are mandatory
+static char *expand_domain(const char *template, const char *ifname)
+{
+    const char *var;
+    size_t len = strlen(template) + 1;
+    size_t varlen = strlen(IFNAME_PLACEHOLDER);
+    size_t ifnamelen = strlen(ifname);
+    char *domain, *p;
+
+    // determine length of expanded string
+    for (var = strstr(template, IFNAME_PLACEHOLDER); var != NULL;
+         var = strstr(var + varlen, IFNAME_PLACEHOLDER)) {
+        len += ifnamelen - varlen;
+    }
+
+    domain = p = malloc(len);
+
+    // replace all occurrences of %i
+    while ((var = strstr(template, IFNAME_PLACEHOLDER)) != NULL) {
+        memcpy(p, template, var - template);
+        p += var - template;
+        memcpy(p, ifname, ifnamelen);
+        p += ifnamelen;
+        template = var + varlen;
+    }
+    strcpy(p, template);
+
+    return domain;
+}
+
+
+static int validate_timeout(cfg_t *cfg, cfg_opt_t *opt, cfg_t *sec)
+{
+    // 0 means not set: inherited from the interface section, or the default
+    if (cfg_getint(sec, "timeout") < 0) {
+        cfg_error(cfg, "Invalid timeout in %s section", cfg_opt_name(opt));
+        return CFG_PARSE_ERROR;
+    }
+
+    return CFG_SUCCESS;
+}
+
+
+static int validate_target_options(cfg_t *cfg, cfg_opt_t *opt, cfg_t *sec)
+{
+    int ret = CFG_SUCCESS;
+
+    // all sub-options without a default are mandatory
     for (cfg_opt_t *subopt = opt->subopts; subopt->type != CFGT_NONE; subopt++) {
-        if (cfg_size(sec, cfg_opt_name(subopt)) < 1) {
-            cfg_error(cfg, "Missing %s in interface section", cfg_opt_name(subopt));
+        if ((subopt->flags & CFGF_NODEFAULT) && cfg_size(sec, cfg_opt_name(subopt)) < 1) {
+            cfg_error(cfg, "Missing %s in %s section", cfg_opt_name(subopt), cfg_opt_name(opt));
             ret = CFG_PARSE_ERROR;
         }
     }
 
+    if (cfg_size(sec, "url") > DDNS_MAX_URLS) {
+        cfg_error(cfg, "More than %d URLs in %s section", DDNS_MAX_URLS, cfg_opt_name(opt));
+        ret = CFG_PARSE_ERROR;
+    }
+
+    if (validate_timeout(cfg, opt, sec) != CFG_SUCCESS) {
+        ret = CFG_PARSE_ERROR;
+    }
+
     return ret;
 }
 
 
+static bool has_target_options(cfg_t *sec)
+{
+    return cfg_size(sec, "url") > 0 || cfg_size(sec, "login") > 0 ||
+           cfg_size(sec, "password") > 0 || cfg_size(sec, "domain") > 0 ||
+           cfg_size(sec, "host") > 0;
+}
+
+
+static int validate_interface_config(cfg_t *cfg, cfg_opt_t *opt)
+{
+    // get the last parsed interface section
+    cfg_t *sec = cfg_opt_getnsec(opt, cfg_opt_size(opt) - 1);
+
+    // update options may be omitted if target sections are given instead,
+    // the timeout is passed down to them
+    if (cfg_size(sec, "target") > 0 && !has_target_options(sec)) {
+        return validate_timeout(cfg, opt, sec);
+    }
+
+    return validate_target_options(cfg, opt, sec);
+}
+
+
+static int validate_target_config(cfg_t *cfg, cfg_opt_t *opt)
+{
+    // get the last parsed target section
+    cfg_t *sec = cfg_opt_getnsec(opt, cfg_opt_size(opt) - 1);
+
+    return validate_target_options(cfg, opt, sec);
+}
+
+
+static int validate_host_config(cfg_t *cfg, cfg_opt_t *opt)
+{
+    struct in6_addr iid;
+
+    // get the last parsed host section
+    cfg_t *sec = cfg_opt_getnsec(opt, cfg_opt_size(opt) - 1);
+    const char *iidstr = cfg_getstr(sec, "iid");
+
+    if (iidstr == NULL) {
+        cfg_error(cfg, "Missing iid in host section %s", cfg_title(sec));
+        return CFG_PARSE_ERROR;
+    }
+    if (inet_pton(AF_INET6, iidstr, &iid) != 1) {
+        cfg_error(cfg, "Invalid iid in host section %s: %s", cfg_title(sec), iidstr);
+        return CFG_PARSE_ERROR;
+    }
+
+    return CFG_SUCCESS;
+}
+
+
 static cfg_t *parse_config(const char *cfgfile)
 {
+    cfg_opt_t host_opts[] = {
+        CFG_STR("iid", 0, CFGF_NODEFAULT),
+        CFG_END()
+    };
+
+    cfg_opt_t target_opts[] = {
+        CFG_STR_LIST("url", 0, CFGF_NODEFAULT),
+        CFG_STR("login", 0, CFGF_NODEFAULT),
+        CFG_STR("password", 0, CFGF_NODEFAULT),
+        CFG_STR("domain", 0, CFGF_NODEFAULT),
+        CFG_INT("timeout", 0, CFGF_NONE),
+        CFG_SEC("host", host_opts, CFGF_MULTI | CFGF_TITLE | CFGF_NO_TITLE_DUPES),
+        CFG_END()
+    };
+
     cfg_opt_t interface_opts[] = {
-        CFG_STR("url", 0, CFGF_NODEFAULT),
+        CFG_STR_LIST("url", 0, CFGF_NODEFAULT),
         CFG_STR("login", 0, CFGF_NODEFAULT),
         CFG_STR("password", 0, CFGF_NODEFAULT),
         CFG_STR("domain", 0, CFGF_NODEFAULT),
+        CFG_INT("timeout", 0, CFGF_NONE),
+        CFG_SEC("host", host_opts, CFGF_MULTI | CFGF_TITLE | CFGF_NO_TITLE_DUPES),
+        CFG_SEC("target", target_opts, CFGF_MULTI),
         CFG_END()
     };
 
@@ -66,6 +202,9 @@ static cfg_t *parse_config(const char *cfgfile)
 
     cfg_t *cfg = cfg_init(opts, CFGF_NONE);
     cfg_set_validate_func(cfg, "interface", validate_interface_config);
+    cfg_set_validate_func(cfg, "interface|host", validate_host_config);
+    cfg_set_validate_func(cfg, "interface|target", validate_target_config);
+    cfg_set_validate_func(cfg, "interface|target|host", validate_host_config);
 
     switch (cfg_parse(cfg, cfgfile)) {
     case CFG_SUCCESS:
@@ -80,6 +219,73 @@ static cfg_t *parse_config(const char *cfgfile)
 }
 
 
+static target_status_t *new_target_status(cfg_t *sec, cfg_t *interface,
+                                          interface_status_t *if_stat)
+{
+    target_status_t *target = calloc(sizeof *target, 1);
+    long timeout;
+
+    ev_timer_init(&target->retry, retry_cb, 0.0, 30.0);
+
+    target->if_stat = if_stat;
+    target->num_urls = cfg_size(sec, "url");
+    target->urls = calloc(target->num_urls, sizeof *target->urls);
+    for (int i = 0; i < target->num_urls; i++) {
+        target->urls[i] = cfg_getnstr(sec, "url", i);
+    }
+
+    // targets without their own timeout use the one of their interface
+    if ((timeout = cfg_getint(sec, "timeout")) == 0 &&
+        (timeout = cfg_getint(interface, "timeout")) == 0) {
+        timeout = DEFAULT_TIMEOUT;
+    }
+    target->request_timeout = timeout;
+
+    target->login = cfg_getstr(sec, "login");
+    target->password = cfg_getstr(sec, "password");
+    target->domain = expand_domain(cfg_getstr(sec, "domain"), if_stat->ifname);
+
+    target->num_hosts = cfg_size(sec, "host");
+
+    for (int i = target->num_hosts - 1; i >= 0; i--) {
+        cfg_t *host = cfg_getnsec(sec, "host", i);
+        host_status_t *host_stat = calloc(sizeof *host_stat, 1);
+
+        host_stat->domain = expand_domain(cfg_title(host), if_stat->ifname);
+        inet_pton(AF_INET6, cfg_getstr(host, "iid"), &host_stat->iid);
+
+        host_stat->next = target->hosts;
+        target->hosts = host_stat;
+    }
+
+    return target;
+}
+
+
+static interface_status_t *new_interface_status(cfg_t *interface, const char *ifname)
+{
+    interface_status_t *if_stat = calloc(sizeof *if_stat, 1);
+    target_status_t **tail = &if_stat->targets;
+
+    ev_timer_init(&if_stat->timeout, timeout_cb, 0.0, 5.0);
+
+    if_stat->ifname = strdup(ifname);
+
+    // update options of the interface section itself form the first target
+    if (cfg_size(interface, "domain") > 0) {
+        *tail = new_target_status(interface, interface, if_stat);
+        tail = &(*tail)->next;
+    }
+
+    for (int i = 0; i < cfg_size(interface, "target"); i++) {
+        *tail = new_target_status(cfg_getnsec(interface, "target", i), interface, if_stat);
+        tail = &(*tail)->next;
+    }
+
+    return if_stat;
+}
+
+
 static void prepare_interface_status(interface_status_t **if_stat_head)
 {
     unsigned int num_interfaces;
@@ -89,16 +295,14 @@ static void prepare_interface_status(interface_status_t **if_stat_head)
     num_interfaces = cfg_size(config, "interface");
 
     for (int i = 0; i < num_interfaces; i++) {
-        if_stat = calloc(sizeof *if_stat, 1);
+        cfg_t *interface = cfg_getnsec(config, "interface", i);
 
-        ev_timer_init(&if_stat->timeout, timeout_cb, 0.0, 5.0);
+        // pattern sections are instantiated on demand
+        if (is_interface_pattern(cfg_title(interface))) {
+            continue;
+        }
 
-        cfg_t *interface = cfg_getnsec(config, "interface", i);
-        if_stat->ifname = cfg_title(interface);
-        if_stat->url = cfg_getstr(interface, "url");
-        if_stat->login = cfg_getstr(interface, "login");
-        if_stat->password = cfg_getstr(interface, "password");
-        if_stat->domain = cfg_getstr(interface, "domain");
+        if_stat = new_interface_status(interface, cfg_title(interface));
 
         if_stat->next = *if_stat_head;
         *if_stat_head = if_stat;
@@ -106,6 +310,51 @@ static void prepare_interface_status(interface_status_t **if_stat_head)
 }
 
 
+interface_status_t *match_interface_pattern(const char *ifname)
+{
+    unsigned int num_interfaces = cfg_size(config, "interface");
+
+    // first matching pattern section wins
+    for (int i = 0; i < num_interfaces; i++) {
+        cfg_t *interface = cfg_getnsec(config, "interface", i);
+        const char *pattern = cfg_title(interface);
+
+        if (is_interface_pattern(pattern) && fnmatch(pattern, ifname, 0) == 0) {
+            interface_status_t *if_stat = new_interface_status(interface, ifname);
+
+            if_stat->dynamic = true;
+            return if_stat;
+        }
+    }
+
+    return NULL;
+}
+
+
+void free_interface_status(interface_status_t *if_stat)
+{
+    while (if_stat->targets != NULL) {
+        target_status_t *target = if_stat->targets;
+
+        while (target->hosts != NULL) {
+            host_status_t *host = target->hosts;
+
+            target->hosts = host->next;
+            free((char *)host->domain);
+            free(host);
+        }
+
+        if_stat->targets = target->next;
+        free(target->urls);
+        free((char *)target->domain);
+        free(target);
+    }
+
+    free((char *)if_stat->ifname);
+    free(if_stat);
+}
+
+
 bool read_config(const char *cfgfile, interface_status_t **if_stat_head)
 {
     config = parse_config(cfgfile);
@@ -20,31 +20,74 @@
 #define _NLDDCD_CONF_H_
 
 #include <stdbool.h>
+#include <time.h>
 #include <netinet/in.h>
 
 #include <ev.h>
 
-typedef struct interface_status {
-    ev_timer timeout;
-    const char *ifname;
-    const char *url;
+#include "net.h"
+
+#define MAX_KNOWN_ADDRS  8      // per interface
+
+typedef struct known_addr {
+    unsigned char family;
+    bool usable;
+    struct in6_addr addr;       // IPv4 addresses use the first 4 bytes
+} known_addr_t;
+
+typedef struct host_status {
+    const char *domain;
+    struct in6_addr iid;
+    struct in6_addr ip6addr;    // local prefix + iid
+    dns_status_t dns;
+    ddns_update_t update;
+    time_t last_update;
+    char last_result[16];
+    unsigned int status_slot;   // 1-based, 0 if not yet published
+    struct host_status *next;
+} host_status_t;
+
+typedef struct target_status {
+    ev_timer retry;
+    const char **urls;
+    unsigned int num_urls;
+    double request_timeout;
     const char *login;
     const char *password;
     const char *domain;
+    dns_status_t dns;
+    ddns_update_t update;
+    host_status_t *hosts;
+    unsigned int num_hosts;
+    time_t last_update;
+    time_t retry_time;          // 0 if no retry pending
+    char last_result[16];
+    unsigned int status_slot;   // 1-based, 0 if not yet published
+    struct interface_status *if_stat;
+    struct target_status *next;
+} target_status_t;
+
+typedef struct interface_status {
+    ev_timer timeout;
+    const char *ifname;
     struct in_addr  local_ipaddr;
-    struct in_addr  dns_ipaddr;
     struct in6_addr local_ip6addr;
-    struct in6_addr dns_ip6addr;
     bool local_ipaddr_set;
-    bool dns_ipaddr_set;
     bool local_ip6addr_set;
-    bool dns_ip6addr_set;
-    bool resolved;
+    struct in6_addr tentative_ip6addr;  // address still in DAD
+    bool tentative_ip6addr_set;
+    ev_tstamp tentative_since;
+    known_addr_t known_addrs[MAX_KNOWN_ADDRS];  // fallbacks for the published addresses
+    unsigned int num_known_addrs;
+    bool dynamic;               // created from a pattern section
+    target_status_t *targets;
     struct interface_status *next;
 } interface_status_t;
 
 
 bool read_config(const char *cfgfile, interface_status_t **if_stat_head);
+interface_status_t *match_interface_pattern(const char *ifname);
+void free_interface_status(interface_status_t *if_stat);
 void cleanup_config(void);
 
 #endif
@@ -0,0 +1,57 @@
+/*
+  Copyright (C) 2017 Christof Efkemann.
+  This file is part of nlddcd.
+
+  nlddcd is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  nlddcd is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with nlddcd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _NLDDCD_HTTP_H_
+#define _NLDDCD_HTTP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <ev.h>
+
+#define NLDDCD_USERAGENT    "nlddcd/1.0"
+#define HTTP_RESPONSE_SIZE  256
+#define HTTP_ERROR_SIZE     256
+#define HTTP_CODE_SIZE      16
+
+typedef struct http_request http_request_t;
+typedef void (*http_done_cb_t)(http_request_t *request);
+
+struct http_request {
+    const char *url;
+    const char *login;
+    const char *password;
+    long timeout_ms;
+    http_done_cb_t done_cb;             // called from the event loop
+    void *data;
+    bool success;                       // a response has been received
+    char response[HTTP_RESPONSE_SIZE];  // body, possibly truncated
+    size_t length;
+    char error_code[HTTP_CODE_SIZE];    // short, e.g. "timeout"
+    char error[HTTP_ERROR_SIZE];
+    void *handle;                       // private to the HTTP client
+    struct http_request *next;          // private to the HTTP client
+};
+
+
+bool http_init(EV_P);
+void http_cleanup(void);
+bool http_start(http_request_t *request);
+void http_cancel(http_request_t *request);
+
+#endif
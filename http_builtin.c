@@ -0,0 +1,958 @@
+/*
+  Copyright (C) 2017 Christof Efkemann.
+  This file is part of nlddcd.
+
+  nlddcd is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  nlddcd is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with nlddcd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_GETADDRINFO_A
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+#ifdef HAVE_MBEDTLS
+#include <mbedtls/ssl.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include <mbedtls/error.h>
+#include <mbedtls/version.h>
+#if MBEDTLS_VERSION_MAJOR >= 3
+#include <psa/crypto.h>
+#endif
+#endif
+
+#include "http.h"
+
+
+#define HTTP_MAX_CONNECTIONS  8
+#define HTTP_BUFFER_SIZE      2048
+#define HTTP_HOST_SIZE        256
+
+#ifndef HTTP_CA_PATH
+#define HTTP_CA_PATH  "/etc/ssl/certs"
+#endif
+
+#define IO_AGAIN  -1
+#define IO_ERROR  -2
+#define IO_RETRY  -3    // nothing read, but call again right away
+
+
+typedef enum {
+    CONN_IDLE,
+    CONN_RESOLVING,
+    CONN_CONNECTING,
+    CONN_HANDSHAKE,
+    CONN_SENDING,
+    CONN_RECEIVING,
+} conn_state_t;
+
+typedef struct {
+    ev_io io;
+    ev_timer timer;                     // request timeout
+    http_request_t *request;
+    conn_state_t state;
+    int fd;
+    bool tls;
+    int events;                         // to wait for
+    char host[HTTP_HOST_SIZE];
+    char port[8];
+    char buffer[HTTP_BUFFER_SIZE];      // request, then response
+    size_t length;
+    size_t sent;
+#ifdef HAVE_GETADDRINFO_A
+    struct addrinfo hints;
+    struct gaicb gai;
+#endif
+#ifdef HAVE_MBEDTLS
+    mbedtls_ssl_context ssl;
+#endif
+} connection_t;
+
+
+static connection_t connections[HTTP_MAX_CONNECTIONS];
+static http_request_t *waiting;         // no free connection yet
+static http_request_t *done;            // to be reported from the loop
+static struct ev_loop *http_loop;
+static ev_timer dispatch_timer;
+#ifdef HAVE_GETADDRINFO_A
+static ev_async resolve_watcher;
+#endif
+
+#ifdef HAVE_MBEDTLS
+static mbedtls_entropy_context entropy;
+static mbedtls_ctr_drbg_context ctr_drbg;
+static mbedtls_x509_crt cacert;
+static mbedtls_ssl_config ssl_conf;
+#endif
+
+
+static void base64_encode(const char *in, size_t len, char *out)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const unsigned char *p = (const unsigned char *)in;
+
+    for (size_t i = 0; i < len; i += 3) {
+        unsigned int n = p[i] << 16;
+
+        if (i + 1 < len) {
+            n |= p[i + 1] << 8;
+        }
+        if (i + 2 < len) {
+            n |= p[i + 2];
+        }
+
+        *out++ = alphabet[(n >> 18) & 0x3f];
+        *out++ = alphabet[(n >> 12) & 0x3f];
+        *out++ = (i + 1 < len) ? alphabet[(n >> 6) & 0x3f] : '=';
+        *out++ = (i + 2 < len) ? alphabet[n & 0x3f] : '=';
+    }
+    *out = 0;
+}
+
+
+static void remove_request(http_request_t **list, http_request_t *request)
+{
+    for (; *list != NULL; list = &(*list)->next) {
+        if (*list == request) {
+            *list = request->next;
+            request->next = NULL;
+            return;
+        }
+    }
+}
+
+
+static void append_request(http_request_t **list, http_request_t *request)
+{
+    while (*list != NULL) {
+        list = &(*list)->next;
+    }
+    request->next = NULL;
+    *list = request;
+}
+
+
+static void close_connection(connection_t *conn)
+{
+    ev_io_stop(http_loop, &conn->io);
+    ev_timer_stop(http_loop, &conn->timer);
+
+    if (conn->request != NULL) {
+        conn->request->handle = NULL;
+        conn->request = NULL;
+    }
+
+#ifdef HAVE_GETADDRINFO_A
+    if (conn->state == CONN_RESOLVING) {
+        // a lookup that is already running keeps the connection busy
+        // until it has finished, see resolve_cb()
+        if (gai_cancel(&conn->gai) == EAI_NOTCANCELED) {
+            return;
+        }
+        if (conn->gai.ar_result != NULL) {
+            freeaddrinfo(conn->gai.ar_result);
+            conn->gai.ar_result = NULL;
+        }
+    }
+#endif
+
+    if (conn->fd >= 0) {
+#ifdef HAVE_MBEDTLS
+        if (conn->tls) {
+            mbedtls_ssl_session_reset(&conn->ssl);
+        }
+#endif
+        close(conn->fd);
+        conn->fd = -1;
+    }
+
+    conn->state = CONN_IDLE;
+}
+
+
+static void complete_request(connection_t *conn, bool success, const char *code,
+                             const char *error)
+{
+    http_request_t *request = conn->request;
+
+    request->success = success;
+    if (error != NULL) {
+        snprintf(request->error_code, sizeof request->error_code, "%s", code);
+        snprintf(request->error, sizeof request->error, "%s", error);
+    }
+
+    close_connection(conn);
+
+    // report from the event loop, never from within http_start()
+    append_request(&done, request);
+    ev_timer_start(http_loop, &dispatch_timer);
+}
+
+
+static bool begin_request(connection_t *conn, http_request_t *request);
+
+
+static void start_waiting_request(connection_t *conn)
+{
+    // hand the connection to the next waiting request
+    while (conn->state == CONN_IDLE && waiting != NULL) {
+        http_request_t *request = waiting;
+
+        remove_request(&waiting, request);
+        if (begin_request(conn, request)) {
+            break;
+        }
+    }
+}
+
+
+static void finish_request(connection_t *conn, bool success, const char *code,
+                           const char *error)
+{
+    complete_request(conn, success, code, error);
+    start_waiting_request(conn);
+}
+
+
+static bool parse_url(connection_t *conn, const char *url, const char **path)
+{
+    char *port = conn->port;
+    size_t portlen = sizeof conn->port;
+    const char *host, *end, *colon;
+    size_t hostlen;
+
+    if (strncasecmp(url, "http://", 7) == 0) {
+        conn->tls = false;
+        host = url + 7;
+        snprintf(port, portlen, "80");
+    }
+    else if (strncasecmp(url, "https://", 8) == 0) {
+        conn->tls = true;
+        host = url + 8;
+        snprintf(port, portlen, "443");
+    }
+    else {
+        return false;
+    }
+
+    end = host + strcspn(host, "/?");
+    *path = end;
+
+    // [IPv6 literal] or host name, optionally followed by :port
+    if (*host == '[') {
+        const char *bracket = memchr(host, ']', end - host);
+
+        if (bracket == NULL) {
+            return false;
+        }
+        colon = (bracket + 1 < end && bracket[1] == ':') ? bracket + 1 : NULL;
+        hostlen = bracket - host - 1;
+        host++;
+    }
+    else {
+        colon = memchr(host, ':', end - host);
+        hostlen = (colon != NULL ? colon : end) - host;
+    }
+
+    if (hostlen == 0 || hostlen >= sizeof conn->host) {
+        return false;
+    }
+    memcpy(conn->host, host, hostlen);
+    conn->host[hostlen] = 0;
+
+    if (colon != NULL) {
+        size_t len = end - colon - 1;
+
+        if (len == 0 || len >= portlen) {
+            return false;
+        }
+        memcpy(port, colon + 1, len);
+        port[len] = 0;
+    }
+
+    return true;
+}
+
+
+static bool build_request(connection_t *conn, const char *url, const char *path)
+{
+    http_request_t *request = conn->request;
+    char credentials[256];
+    char auth[(sizeof credentials + 2) / 3 * 4 + 1];
+    const char *authority = strstr(url, "://") + 3;
+    int len;
+
+    len = snprintf(credentials, sizeof credentials, "%s:%s", request->login, request->password);
+    if (len < 0 || len >= sizeof credentials) {
+        return false;
+    }
+    base64_encode(credentials, len, auth);
+
+    len = snprintf(conn->buffer, sizeof conn->buffer,
+                   "GET %s%s HTTP/1.1\r\n"
+                   "Host: %.*s\r\n"
+                   "User-Agent: " NLDDCD_USERAGENT "\r\n"
+                   "Authorization: Basic %s\r\n"
+                   "Connection: close\r\n"
+                   "\r\n",
+                   (*path == '/') ? "" : "/", path,
+                   (int)(path - authority), authority, auth);
+    if (len < 0 || len >= sizeof conn->buffer) {
+        return false;
+    }
+
+    conn->length = len;
+    conn->sent = 0;
+    return true;
+}
+
+
+static void watch_connection(connection_t *conn)
+{
+    ev_io_stop(http_loop, &conn->io);
+    ev_io_set(&conn->io, conn->fd, conn->events);
+    ev_io_start(http_loop, &conn->io);
+}
+
+
+static bool open_connection(connection_t *conn, const struct addrinfo *addr)
+{
+    conn->fd = socket(addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (conn->fd < 0 ||
+        (connect(conn->fd, addr->ai_addr, addr->ai_addrlen) < 0 && errno != EINPROGRESS)) {
+        return false;
+    }
+
+#ifdef HAVE_MBEDTLS
+    if (conn->tls) {
+        mbedtls_ssl_set_hostname(&conn->ssl, conn->host);
+    }
+#endif
+
+    conn->state = CONN_CONNECTING;
+    conn->events = EV_WRITE;
+    watch_connection(conn);
+    return true;
+}
+
+
+#ifdef HAVE_GETADDRINFO_A
+// runs in a thread started by getaddrinfo_a()
+static void resolve_notify(union sigval sv)
+{
+    ev_async_send(http_loop, &resolve_watcher);
+}
+#endif
+
+
+static bool begin_request(connection_t *conn, http_request_t *request)
+{
+    const char *path;
+    const char *code = "url";
+    const char *error = NULL;
+    int ret;
+
+    conn->request = request;
+    conn->fd = -1;
+    request->handle = conn;
+
+    if (!parse_url(conn, request->url, &path)) {
+        error = "Malformed URL";
+    }
+#ifndef HAVE_MBEDTLS
+    else if (conn->tls) {
+        code = "protocol";
+        error = "HTTPS not supported";
+    }
+#endif
+    else if (!build_request(conn, request->url, path)) {
+        error = "Request too long";
+    }
+
+    if (error != NULL) {
+        complete_request(conn, false, code, error);
+        return false;
+    }
+
+    ev_timer_set(&conn->timer, request->timeout_ms / 1000.0, 0.0);
+    ev_timer_start(http_loop, &conn->timer);
+
+#ifdef HAVE_GETADDRINFO_A
+    struct gaicb *list[] = { &conn->gai };
+    struct sigevent sev;
+
+    memset(&conn->hints, 0, sizeof conn->hints);
+    conn->hints.ai_family = AF_UNSPEC;
+    conn->hints.ai_socktype = SOCK_STREAM;
+    memset(&conn->gai, 0, sizeof conn->gai);
+    conn->gai.ar_name = conn->host;
+    conn->gai.ar_service = conn->port;
+    conn->gai.ar_request = &conn->hints;
+
+    memset(&sev, 0, sizeof sev);
+    sev.sigev_notify = SIGEV_THREAD;
+    sev.sigev_notify_function = resolve_notify;
+
+    // continued in resolve_cb()
+    ret = getaddrinfo_a(GAI_NOWAIT, list, 1, &sev);
+    if (ret != 0) {
+        complete_request(conn, false, "resolve", gai_strerror(ret));
+        return false;
+    }
+    conn->state = CONN_RESOLVING;
+#else
+    struct addrinfo hints, *result;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    // without getaddrinfo_a(), host names are resolved synchronously
+    ret = getaddrinfo(conn->host, conn->port, &hints, &result);
+    if (ret != 0) {
+        complete_request(conn, false, "resolve", gai_strerror(ret));
+        return false;
+    }
+
+    if (!open_connection(conn, result)) {
+        freeaddrinfo(result);
+        complete_request(conn, false, "connect", strerror(errno));
+        return false;
+    }
+    freeaddrinfo(result);
+#endif
+
+    return true;
+}
+
+
+#ifdef HAVE_MBEDTLS
+static int tls_send_cb(void *ctx, const unsigned char *buf, size_t len)
+{
+    connection_t *conn = ctx;
+    ssize_t n = send(conn->fd, buf, len, MSG_NOSIGNAL);
+
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ?
+            MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    return n;
+}
+
+
+static int tls_recv_cb(void *ctx, unsigned char *buf, size_t len)
+{
+    connection_t *conn = ctx;
+    ssize_t n = recv(conn->fd, buf, len, 0);
+
+    if (n < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ?
+            MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+    return n;
+}
+
+
+static const char *tls_strerror(int ret)
+{
+    static char errbuf[HTTP_ERROR_SIZE];
+
+    mbedtls_strerror(ret, errbuf, sizeof errbuf);
+    return errbuf;
+}
+
+
+static ssize_t tls_result(connection_t *conn, int ret)
+{
+    switch (ret) {
+    case MBEDTLS_ERR_SSL_WANT_READ:
+        conn->events = EV_READ;
+        return IO_AGAIN;
+    case MBEDTLS_ERR_SSL_WANT_WRITE:
+        conn->events = EV_WRITE;
+        return IO_AGAIN;
+#ifdef MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET
+    case MBEDTLS_ERR_SSL_RECEIVED_NEW_SESSION_TICKET:
+        // TLS 1.3 servers send session tickets after the handshake,
+        // the response may already be buffered behind them
+        return IO_RETRY;
+#endif
+    case MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY:
+    case MBEDTLS_ERR_SSL_CONN_EOF:
+        return 0;
+    default:
+        return (ret >= 0) ? ret : IO_ERROR;
+    }
+}
+#endif
+
+
+static ssize_t conn_send(connection_t *conn, const char *buf, size_t len)
+{
+    ssize_t n;
+
+#ifdef HAVE_MBEDTLS
+    if (conn->tls) {
+        return tls_result(conn, mbedtls_ssl_write(&conn->ssl, (const unsigned char *)buf, len));
+    }
+#endif
+
+    n = send(conn->fd, buf, len, MSG_NOSIGNAL);
+    if (n < 0) {
+        conn->events = EV_WRITE;
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? IO_AGAIN : IO_ERROR;
+    }
+    return n;
+}
+
+
+static ssize_t conn_recv(connection_t *conn, char *buf, size_t len)
+{
+    ssize_t n;
+
+#ifdef HAVE_MBEDTLS
+    if (conn->tls) {
+        do {
+            n = tls_result(conn, mbedtls_ssl_read(&conn->ssl, (unsigned char *)buf, len));
+        } while (n == IO_RETRY);
+        return n;
+    }
+#endif
+
+    n = recv(conn->fd, buf, len, 0);
+    if (n < 0) {
+        conn->events = EV_READ;
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? IO_AGAIN : IO_ERROR;
+    }
+    return n;
+}
+
+
+static const char *find_header(const char *headers, const char *name)
+{
+    size_t namelen = strlen(name);
+    const char *line = strstr(headers, "\r\n");
+
+    // header lines follow the status line
+    while (line != NULL && line[2] != '\r') {
+        line += 2;
+        if (strncasecmp(line, name, namelen) == 0 && line[namelen] == ':') {
+            return line + namelen + 1 + strspn(line + namelen + 1, " \t");
+        }
+        line = strstr(line, "\r\n");
+    }
+
+    return NULL;
+}
+
+
+// returns false once the response buffer is full
+static bool copy_body(http_request_t *request, const char *body, size_t len)
+{
+    size_t bytes_free = sizeof request->response - 1 - request->length;
+    size_t n = (len < bytes_free) ? len : bytes_free;
+
+    memcpy(request->response + request->length, body, n);
+    request->length += n;
+    request->response[request->length] = 0;
+
+    return request->length < sizeof request->response - 1;
+}
+
+
+// returns true once the complete response has been received
+static bool parse_response(connection_t *conn, bool eof)
+{
+    http_request_t *request = conn->request;
+    const char *header, *body;
+    size_t bodylen;
+
+    conn->buffer[conn->length] = 0;
+
+    if ((body = strstr(conn->buffer, "\r\n\r\n")) == NULL) {
+        if (eof || conn->length == sizeof conn->buffer - 1) {
+            finish_request(conn, false, "protocol", "Invalid response");
+            return true;
+        }
+        return false;
+    }
+    body += 4;
+    bodylen = conn->length - (body - conn->buffer);
+
+    if (strncmp(conn->buffer, "HTTP/1.", 7) != 0) {
+        finish_request(conn, false, "protocol", "Invalid response");
+        return true;
+    }
+
+    request->length = 0;
+
+    if ((header = find_header(conn->buffer, "Transfer-Encoding")) != NULL &&
+        strncasecmp(header, "chunked", 7) == 0) {
+        // wait for the terminating chunk (or end of connection)
+        const char *p = body;
+        const char *end = body + bodylen;
+
+        while (p < end) {
+            char *ext;
+            unsigned long size = strtoul(p, &ext, 16);
+            const char *data = strstr(ext, "\r\n");
+
+            if (data == NULL || size == 0) {
+                break;
+            }
+            data += 2;
+            if (size > end - data) {
+                size = end - data;
+            }
+            if (!copy_body(request, data, size)) {
+                break;
+            }
+            p = data + size + 2;
+        }
+
+        if (!eof && conn->length < sizeof conn->buffer - 1 &&
+            strstr(body, "\r\n0\r\n") == NULL && strncmp(body, "0\r\n", 3) != 0) {
+            return false;
+        }
+    }
+    else {
+        if ((header = find_header(conn->buffer, "Content-Length")) != NULL) {
+            unsigned long content_length = strtoul(header, NULL, 10);
+
+            if (bodylen < content_length && !eof && conn->length < sizeof conn->buffer - 1) {
+                return false;
+            }
+            if (bodylen > content_length) {
+                bodylen = content_length;
+            }
+        }
+        else if (!eof && conn->length < sizeof conn->buffer - 1) {
+            return false;
+        }
+        copy_body(request, body, bodylen);
+    }
+
+    finish_request(conn, true, NULL, NULL);
+    return true;
+}
+
+
+static void process_connection(connection_t *conn)
+{
+    ssize_t n;
+    int err;
+    socklen_t errlen = sizeof err;
+
+    for (;;) {
+        switch (conn->state) {
+        case CONN_CONNECTING:
+            if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0) {
+                err = errno;
+            }
+            if (err != 0) {
+                finish_request(conn, false, "connect", strerror(err));
+                return;
+            }
+            conn->state = conn->tls ? CONN_HANDSHAKE : CONN_SENDING;
+            break;
+
+        case CONN_HANDSHAKE:
+#ifdef HAVE_MBEDTLS
+            n = mbedtls_ssl_handshake(&conn->ssl);
+            if (n != 0) {
+                if (tls_result(conn, n) != IO_AGAIN) {
+                    finish_request(conn, false, "tls", tls_strerror(n));
+                }
+                return;
+            }
+#endif
+            conn->state = CONN_SENDING;
+            break;
+
+        case CONN_SENDING:
+            n = conn_send(conn, conn->buffer + conn->sent, conn->length - conn->sent);
+            if (n == IO_AGAIN) {
+                return;
+            }
+            if (n < 0) {
+                finish_request(conn, false, "send", "Failed sending data to the peer");
+                return;
+            }
+            conn->sent += n;
+            if (conn->sent == conn->length) {
+                conn->length = 0;
+                conn->state = CONN_RECEIVING;
+            }
+            break;
+
+        case CONN_RECEIVING:
+            n = conn_recv(conn, conn->buffer + conn->length,
+                          sizeof conn->buffer - conn->length - 1);
+            if (n == IO_AGAIN) {
+                return;
+            }
+            if (n < 0) {
+                finish_request(conn, false, "recv", "Failure when receiving data from the peer");
+                return;
+            }
+            conn->length += n;
+            if (parse_response(conn, n == 0)) {
+                return;
+            }
+            break;
+
+        case CONN_IDLE:
+        case CONN_RESOLVING:
+            return;
+        }
+    }
+}
+
+
+#ifdef HAVE_GETADDRINFO_A
+static void resolve_cb(EV_P_ ev_async *w, int revents)
+{
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        connection_t *conn = &connections[i];
+        struct addrinfo *result;
+        int ret;
+
+        if (conn->state != CONN_RESOLVING ||
+            (ret = gai_error(&conn->gai)) == EAI_INPROGRESS) {
+            continue;
+        }
+
+        result = conn->gai.ar_result;
+        conn->gai.ar_result = NULL;
+
+        if (conn->request == NULL) {
+            // cancelled while resolving
+            if (result != NULL) {
+                freeaddrinfo(result);
+            }
+            conn->state = CONN_IDLE;
+            start_waiting_request(conn);
+        }
+        else if (ret != 0) {
+            finish_request(conn, false, "resolve", gai_strerror(ret));
+        }
+        else {
+            if (!open_connection(conn, result)) {
+                finish_request(conn, false, "connect", strerror(errno));
+            }
+            freeaddrinfo(result);
+        }
+    }
+}
+#endif
+
+
+static void io_cb(EV_P_ ev_io *w, int revents)
+{
+    connection_t *conn = w->data;
+    http_request_t *request = conn->request;
+
+    process_connection(conn);
+
+    // unless finished, wait for whatever the connection is blocked on
+    if (conn->request == request && conn->state != CONN_IDLE) {
+        watch_connection(conn);
+    }
+}
+
+
+static void timeout_cb(EV_P_ ev_timer *w, int revents)
+{
+    connection_t *conn = w->data;
+
+    finish_request(conn, false, "timeout", "Operation timed out");
+}
+
+
+static void dispatch_cb(EV_P_ ev_timer *w, int revents)
+{
+    http_request_t *request;
+
+    while ((request = done) != NULL) {
+        remove_request(&done, request);
+        request->done_cb(request);
+    }
+}
+
+
+bool http_start(http_request_t *request)
+{
+    request->error_code[0] = 0;
+    request->error[0] = 0;
+    request->response[0] = 0;
+    request->length = 0;
+    request->success = false;
+    request->handle = NULL;
+
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (connections[i].state == CONN_IDLE) {
+            begin_request(&connections[i], request);
+            return true;
+        }
+    }
+
+    // all connections busy
+    append_request(&waiting, request);
+    return true;
+}
+
+
+void http_cancel(http_request_t *request)
+{
+    connection_t *conn = request->handle;
+
+    if (conn != NULL) {
+        close_connection(conn);
+        start_waiting_request(conn);
+    }
+    else {
+        remove_request(&waiting, request);
+        remove_request(&done, request);
+    }
+}
+
+
+bool http_init(EV_P)
+{
+    http_loop = EV_A;
+
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        connection_t *conn = &connections[i];
+
+        conn->state = CONN_IDLE;
+        conn->fd = -1;
+        ev_init(&conn->io, io_cb);
+        conn->io.data = conn;
+        ev_init(&conn->timer, timeout_cb);
+        conn->timer.data = conn;
+    }
+
+    ev_timer_init(&dispatch_timer, dispatch_cb, 0.0, 0.0);
+
+#ifdef HAVE_GETADDRINFO_A
+    // must not keep the loop alive by itself
+    ev_async_init(&resolve_watcher, resolve_cb);
+    ev_async_start(EV_A_ &resolve_watcher);
+    ev_unref(EV_A);
+#endif
+
+#ifdef HAVE_MBEDTLS
+    int ret;
+
+#if MBEDTLS_VERSION_MAJOR >= 3
+    if (psa_crypto_init() != PSA_SUCCESS) {
+        fprintf(stderr, "psa_crypto_init failed\n");
+        return false;
+    }
+#endif
+
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&ctr_drbg);
+    mbedtls_x509_crt_init(&cacert);
+    mbedtls_ssl_config_init(&ssl_conf);
+
+    ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy, NULL, 0);
+    if (ret == 0) {
+        if (mbedtls_x509_crt_parse_path(&cacert, HTTP_CA_PATH) < 0) {
+            fprintf(stderr, "warning: failed to load CA certificates from %s\n", HTTP_CA_PATH);
+        }
+        ret = mbedtls_ssl_config_defaults(&ssl_conf, MBEDTLS_SSL_IS_CLIENT,
+                                          MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (ret != 0) {
+        fprintf(stderr, "TLS initialization failed: %s\n", tls_strerror(ret));
+        http_cleanup();
+        return false;
+    }
+
+    mbedtls_ssl_conf_authmode(&ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&ssl_conf, &cacert, NULL);
+    mbedtls_ssl_conf_rng(&ssl_conf, mbedtls_ctr_drbg_random, &ctr_drbg);
+
+    // TLS contexts are set up once and reset after every request
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        mbedtls_ssl_init(&connections[i].ssl);
+        if (mbedtls_ssl_setup(&connections[i].ssl, &ssl_conf) != 0) {
+            fprintf(stderr, "TLS initialization failed\n");
+            http_cleanup();
+            return false;
+        }
+        mbedtls_ssl_set_bio(&connections[i].ssl, &connections[i],
+                            tls_send_cb, tls_recv_cb, NULL);
+    }
+#endif
+
+    return true;
+}
+
+
+void http_cleanup(void)
+{
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        connection_t *conn = &connections[i];
+
+        close_connection(conn);
+
+#ifdef HAVE_GETADDRINFO_A
+        // wait for lookups that could not be cancelled
+        if (conn->state == CONN_RESOLVING) {
+            const struct gaicb *list[] = { &conn->gai };
+
+            while (gai_error(&conn->gai) == EAI_INPROGRESS) {
+                gai_suspend(list, 1, NULL);
+            }
+            if (conn->gai.ar_result != NULL) {
+                freeaddrinfo(conn->gai.ar_result);
+            }
+            conn->state = CONN_IDLE;
+        }
+#endif
+    }
+
+    ev_timer_stop(http_loop, &dispatch_timer);
+
+#ifdef HAVE_GETADDRINFO_A
+    ev_ref(http_loop);
+    ev_async_stop(http_loop, &resolve_watcher);
+#endif
+
+#ifdef HAVE_MBEDTLS
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        mbedtls_ssl_free(&connections[i].ssl);
+    }
+    mbedtls_ssl_config_free(&ssl_conf);
+    mbedtls_x509_crt_free(&cacert);
+    mbedtls_ctr_drbg_free(&ctr_drbg);
+    mbedtls_entropy_free(&entropy);
+#endif
+}
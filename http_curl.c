@@ -0,0 +1,226 @@
+/*
+  Copyright (C) 2017 Christof Efkemann.
+  This file is part of nlddcd.
+
+  nlddcd is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  nlddcd is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with nlddcd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <curl/curl.h>
+
+#include "http.h"
+
+
+#define MIN(a, b)  (((a) < (b)) ? (a) : (b))
+
+
+static CURLM *multi;
+static struct ev_loop *http_loop;
+static ev_timer multi_timer;
+
+
+static size_t curl_recv_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    http_request_t *request = userdata;
+    size_t bytes_avail = size * nmemb;
+    size_t bytes_free = sizeof request->response - request->length - 1;
+    size_t bytes_to_copy = MIN(bytes_avail, bytes_free);
+
+    memcpy(request->response + request->length, ptr, bytes_to_copy);
+    request->length += bytes_to_copy;
+
+    return bytes_avail;
+}
+
+
+bool http_start(http_request_t *request)
+{
+    CURL *curl;
+
+    if ((curl = curl_easy_init()) == NULL) {
+        return false;
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, request->url);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, NLDDCD_USERAGENT);
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+    curl_easy_setopt(curl, CURLOPT_USERNAME, request->login);
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, request->password);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_recv_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, request);
+    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, request->error);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, request);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, request->timeout_ms);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+    request->error_code[0] = 0;
+    request->error[0] = 0;
+    request->length = 0;
+    request->success = false;
+    request->handle = curl;
+
+    curl_multi_add_handle(multi, curl);
+
+    return true;
+}
+
+
+void http_cancel(http_request_t *request)
+{
+    if (request->handle != NULL) {
+        curl_multi_remove_handle(multi, request->handle);
+        curl_easy_cleanup(request->handle);
+        request->handle = NULL;
+    }
+}
+
+
+static void check_multi_info(void)
+{
+    CURLMsg *msg;
+    int msgs_left;
+    http_request_t *request;
+
+    while ((msg = curl_multi_info_read(multi, &msgs_left)) != NULL) {
+        if (msg->msg == CURLMSG_DONE) {
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &request);
+
+            if (msg->data.result == CURLE_OK) {
+                request->response[request->length] = 0;
+                request->success = true;
+            }
+            else {
+                size_t len = strlen(request->error);
+
+                snprintf(request->error_code, sizeof request->error_code,
+                         "error %d", msg->data.result);
+                if (len == 0) {
+                    snprintf(request->error, sizeof request->error, "(%d) %s",
+                             msg->data.result, curl_easy_strerror(msg->data.result));
+                }
+                else if (request->error[len - 1] == '\n') {
+                    request->error[len - 1] = 0;
+                }
+            }
+
+            http_cancel(request);
+            request->done_cb(request);
+        }
+    }
+}
+
+
+static void socket_action(curl_socket_t fd, int action)
+{
+    CURLMcode mc;
+    int running;
+
+    mc = curl_multi_socket_action(multi, fd, action, &running);
+    if (mc != CURLM_OK) {
+        fprintf(stderr, "error: %s\n", curl_multi_strerror(mc));
+    }
+
+    check_multi_info();
+}
+
+
+static void io_cb(EV_P_ ev_io *w, int revents)
+{
+    int action = ((revents & EV_READ) ? CURL_CSELECT_IN : 0) |
+                 ((revents & EV_WRITE) ? CURL_CSELECT_OUT : 0);
+
+    socket_action(w->fd, action);
+}
+
+
+static void timer_cb(EV_P_ ev_timer *w, int revents)
+{
+    socket_action(CURL_SOCKET_TIMEOUT, 0);
+}
+
+
+// called by curl to tell which events to watch on a socket
+static int multi_socket_cb(CURL *curl, curl_socket_t fd, int what, void *userp, void *socketp)
+{
+    ev_io *watcher = socketp;
+
+    if (what == CURL_POLL_REMOVE) {
+        if (watcher != NULL) {
+            ev_io_stop(http_loop, watcher);
+            free(watcher);
+        }
+        return 0;
+    }
+
+    if (watcher == NULL) {
+        watcher = malloc(sizeof *watcher);
+        ev_init(watcher, io_cb);
+        curl_multi_assign(multi, fd, watcher);
+    }
+    else {
+        ev_io_stop(http_loop, watcher);
+    }
+
+    ev_io_set(watcher, fd, ((what & CURL_POLL_IN) ? EV_READ : 0) |
+                           ((what & CURL_POLL_OUT) ? EV_WRITE : 0));
+    ev_io_start(http_loop, watcher);
+
+    return 0;
+}
+
+
+// called by curl to (re)arm its single timeout
+static int multi_timer_cb(CURLM *multi, long timeout_ms, void *userp)
+{
+    ev_timer_stop(http_loop, &multi_timer);
+
+    if (timeout_ms >= 0) {
+        ev_timer_set(&multi_timer, timeout_ms / 1000.0, 0.0);
+        ev_timer_start(http_loop, &multi_timer);
+    }
+
+    return 0;
+}
+
+
+bool http_init(EV_P)
+{
+    http_loop = EV_A;
+
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        return false;
+    }
+
+    if ((multi = curl_multi_init()) == NULL) {
+        curl_global_cleanup();
+        return false;
+    }
+
+    ev_init(&multi_timer, timer_cb);
+    curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, multi_socket_cb);
+    curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, multi_timer_cb);
+
+    return true;
+}
+
+
+void http_cleanup(void)
+{
+    ev_timer_stop(http_loop, &multi_timer);
+    curl_multi_cleanup(multi);
+    curl_global_cleanup();
+}
@@ -16,196 +16,760 @@
   along with nlddcd.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#ifdef HAVE_GETADDRINFO_A
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 
-#include <curl/curl.h>
-
 #include "net.h"
+#include "http.h"
+
+
+#define EWMA_WEIGHT        0.3
+#define BREAKER_THRESHOLD  3        // consecutive failures
+#define BREAKER_COOLDOWN   60.0     // seconds
+#define MIN_HEDGE_DELAY    0.5      // seconds
+
+
+typedef struct endpoint {
+    char *url;
+    double latency;             // EWMA of response time, in seconds
+    double error_rate;          // EWMA of failed attempts
+    unsigned int samples;
+    unsigned int failures;      // consecutive failures
+    double open_until;          // circuit breaker open until this time
+    struct ddns_attempt *probe; // single attempt let through afterwards
+    struct endpoint *next;
+} endpoint_t;
+
+#ifdef HAVE_GETADDRINFO_A
+typedef struct dns_lookup {
+    dns_status_t *dns;                  // NULL if cancelled
+    bool busy;                          // until getaddrinfo_a() has finished
+    char name[256];
+    struct addrinfo hints;
+    struct gaicb gai;
+} dns_lookup_t;
+#endif
+
+
+static endpoint_t *endpoints;
+static struct ev_loop *net_loop;
+#ifdef HAVE_GETADDRINFO_A
+static dns_lookup_t lookups[DNS_MAX_LOOKUPS];
+static dns_status_t *waiting_lookups;   // no free lookup yet
+static ev_async lookup_watcher;
+#endif
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
 
+static endpoint_t *get_endpoint(const char *url)
+{
+    endpoint_t *endpoint;
 
-#define NLDDCD_USERAGENT  "nlddcd/1.0"
-#define MIN(a, b)  (((a) < (b)) ? (a) : (b))
+    // endpoints are shared by all interfaces using the same URL
+    for (endpoint = endpoints; endpoint != NULL; endpoint = endpoint->next) {
+        if (strcmp(endpoint->url, url) == 0) {
+            return endpoint;
+        }
+    }
 
+    endpoint = calloc(sizeof *endpoint, 1);
+    endpoint->url = strdup(url);
+    endpoint->next = endpoints;
+    endpoints = endpoint;
 
-typedef struct {
-    char data[256];
-    size_t length;
-} response_t;
+    return endpoint;
+}
 
 
-static size_t curl_recv_cb(char *ptr, size_t size, size_t nmemb, void *userdata)
+static bool endpoint_available(const endpoint_t *endpoint, double t)
 {
-    response_t *response = userdata;
-    size_t bytes_avail = size * nmemb;
-    size_t bytes_free = sizeof response->data - response->length - 1;
-    size_t bytes_to_copy = MIN(bytes_avail, bytes_free);
+    // an open breaker lets a single probe through after the cooldown
+    if (endpoint->failures < BREAKER_THRESHOLD) {
+        return true;
+    }
+    return t >= endpoint->open_until && endpoint->probe == NULL;
+}
 
-    memcpy(response->data + response->length, ptr, bytes_to_copy);
-    response->length += bytes_to_copy;
 
-    return bytes_avail;
+static double endpoint_cost(const endpoint_t *endpoint, double timeout)
+{
+    // expected time until a successful response; unknown endpoints are
+    // assumed to answer within half the timeout, so they get tried once a
+    // measured endpoint turns out to be slower than that
+    if (endpoint->samples == 0) {
+        return timeout / 2;
+    }
+    return endpoint->latency + endpoint->error_rate * timeout;
 }
 
 
-static void print_curl_error(CURLcode res, const char *errorbuffer)
+static void record_attempt(endpoint_t *endpoint, bool success, double latency)
 {
-    size_t len = strlen(errorbuffer);
+    double failed = success ? 0.0 : 1.0;
 
-    fprintf(stderr, "error: (%d) ", res);
-    if (len > 0) {
-        fprintf(stderr, "%s%s", errorbuffer,
-                ((errorbuffer[len - 1] != '\n') ? "\n" : ""));
+    if (endpoint->samples == 0) {
+        endpoint->error_rate = failed;
+        if (success) {
+            endpoint->latency = latency;
+        }
     }
     else {
-        fprintf(stderr, "%s\n", curl_easy_strerror(res));
+        endpoint->error_rate += EWMA_WEIGHT * (failed - endpoint->error_rate);
+        if (success) {
+            endpoint->latency += EWMA_WEIGHT * (latency - endpoint->latency);
+        }
+    }
+    endpoint->samples++;
+
+    if (success) {
+        endpoint->failures = 0;
+    }
+    else if (++endpoint->failures >= BREAKER_THRESHOLD) {
+        printf("%s failed %u times, suspending for %.0f seconds\n",
+               endpoint->url, endpoint->failures, BREAKER_COOLDOWN);
+        endpoint->open_until = now() + BREAKER_COOLDOWN;
+    }
+}
+
+
+static void record_cancelled_attempt(endpoint_t *endpoint, double elapsed)
+{
+    // the response would have taken at least elapsed seconds; that is
+    // only news if the endpoint is usually faster
+    if (endpoint->samples == 0) {
+        endpoint->latency = elapsed;
+    }
+    else if (elapsed > endpoint->latency) {
+        endpoint->latency += EWMA_WEIGHT * (elapsed - endpoint->latency);
+    }
+    else {
+        return;
+    }
+    endpoint->samples++;
+}
+
+
+static void rank_endpoints(ddns_update_t *update)
+{
+    double t = now();
+
+    update->num_candidates = 0;
+    for (unsigned int i = 0; i < update->num_urls && i < DDNS_MAX_URLS; i++) {
+        update->candidates[update->num_candidates++] = get_endpoint(update->urls[i]);
+    }
+    update->next_candidate = 0;
+
+    // stable insertion sort: available endpoints first, then by cost
+    for (unsigned int i = 1; i < update->num_candidates; i++) {
+        endpoint_t *endpoint = update->candidates[i];
+        bool available = endpoint_available(endpoint, t);
+        double cost = endpoint_cost(endpoint, update->timeout);
+        unsigned int j = i;
+
+        while (j > 0) {
+            endpoint_t *prev = update->candidates[j - 1];
+            bool prev_available = endpoint_available(prev, t);
+
+            if (prev_available > available ||
+                (prev_available == available && endpoint_cost(prev, update->timeout) <= cost)) {
+                break;
+            }
+            update->candidates[j] = prev;
+            j--;
+        }
+        update->candidates[j] = endpoint;
+    }
+
+    // suspended endpoints are skipped, unless there is nothing else
+    update->all_suspended = true;
+    for (unsigned int i = 0; i < update->num_candidates; i++) {
+        if (!endpoint_available(update->candidates[i], t)) {
+            if (i > 0) {
+                update->num_candidates = i;
+                update->all_suspended = false;
+            }
+            return;
+        }
     }
+    update->all_suspended = false;
 }
 
 
-bool perform_ddns_update(interface_status_t *if_stat)
+static endpoint_t *next_candidate(ddns_update_t *update)
 {
-    CURL *curl;
+    double t = now();
+
+    // another update may have taken the probe of an endpoint meanwhile
+    while (update->next_candidate < update->num_candidates) {
+        endpoint_t *endpoint = update->candidates[update->next_candidate];
+
+        if (update->all_suspended || endpoint_available(endpoint, t)) {
+            return endpoint;
+        }
+        update->next_candidate++;
+    }
+    return NULL;
+}
+
+
+static double hedge_delay(const endpoint_t *endpoint, double timeout)
+{
+    double delay = timeout / 2;
+
+    // give a known endpoint a few times its usual response time
+    if (endpoint->samples > 0 && endpoint->latency * 3 < delay) {
+        delay = endpoint->latency * 3;
+    }
+    return (delay > MIN_HEDGE_DELAY) ? delay : MIN_HEDGE_DELAY;
+}
+
+
+static bool build_url(ddns_attempt_t *attempt)
+{
+    ddns_update_t *update = attempt->update;
     char ipaddrstr[INET_ADDRSTRLEN];
     char ip6addrstr[INET6_ADDRSTRLEN];
-    size_t urllen = strlen(if_stat->url) + strlen(if_stat->domain) + 128;
-    char *urlbuffer = malloc(urllen);
-    char *errorbuffer = malloc(CURL_ERROR_SIZE);
-    response_t *response = malloc(sizeof *response);
+    int len;
+
+    if (update->ipaddr_set) {
+        inet_ntop(AF_INET, &update->ipaddr, ipaddrstr, sizeof ipaddrstr);
+    }
+    if (update->ip6addr_set) {
+        inet_ntop(AF_INET6, &update->ip6addr, ip6addrstr, sizeof ip6addrstr);
+    }
+
+    len = snprintf(attempt->url, sizeof attempt->url, "%s?hostname=%s&myip=%s%s%s",
+                   attempt->endpoint->url, update->domain,
+                   update->ipaddr_set ? ipaddrstr : "",
+                   (update->ipaddr_set && update->ip6addr_set) ? "," : "",
+                   update->ip6addr_set ? ip6addrstr : "");
+
+    return len >= 0 && len < sizeof attempt->url;
+}
+
+
+static void arm_hedge_timer(ddns_update_t *update)
+{
+    double delay = update->hedge_time - now();
+
+    ev_timer_stop(net_loop, &update->hedge_timer);
+
+    if (update->active > 0 && update->active < DDNS_MAX_ATTEMPTS &&
+        update->next_candidate < update->num_candidates) {
+        ev_timer_set(&update->hedge_timer, (delay > 0.0) ? delay : 0.0, 0.0);
+        ev_timer_start(net_loop, &update->hedge_timer);
+    }
+}
+
+
+static void attempt_done_cb(http_request_t *http);
+
+
+static bool start_attempt(ddns_update_t *update)
+{
+    ddns_attempt_t *attempt = NULL;
+    endpoint_t *endpoint;
+
+    for (unsigned int i = 0; i < DDNS_MAX_ATTEMPTS; i++) {
+        if (!update->attempts[i].running) {
+            attempt = &update->attempts[i];
+            break;
+        }
+    }
+    if (attempt == NULL) {
+        return false;
+    }
+
+    while ((endpoint = next_candidate(update)) != NULL) {
+        update->next_candidate++;
+        attempt->update = update;
+        attempt->endpoint = endpoint;
+
+        if (!build_url(attempt)) {
+            fprintf(stderr, "%s: error: URL too long\n", attempt->endpoint->url);
+            continue;
+        }
+
+        attempt->http.url = attempt->url;
+        attempt->http.login = update->login;
+        attempt->http.password = update->password;
+        attempt->http.timeout_ms = update->timeout * 1000;
+        attempt->http.done_cb = attempt_done_cb;
+        attempt->http.data = attempt;
+
+        if (http_start(&attempt->http)) {
+            attempt->start_time = now();
+            attempt->running = true;
+
+            if (endpoint->failures >= BREAKER_THRESHOLD && endpoint->probe == NULL) {
+                endpoint->probe = attempt;
+            }
+
+            update->active++;
+            update->hedge_time = attempt->start_time +
+                hedge_delay(attempt->endpoint, update->timeout);
+            arm_hedge_timer(update);
+            return true;
+        }
+    }
+
+    // no endpoint left to try
+    return false;
+}
+
+
+static void end_probe(ddns_attempt_t *attempt)
+{
+    // a cancelled probe has no verdict, the next update probes again
+    if (attempt->endpoint->probe == attempt) {
+        attempt->endpoint->probe = NULL;
+    }
+}
+
+
+static void stop_attempt(ddns_attempt_t *attempt)
+{
+    if (attempt->running) {
+        http_cancel(&attempt->http);
+        end_probe(attempt);
+        attempt->running = false;
+        attempt->update->active--;
+    }
+}
+
+
+static void finish_update(ddns_update_t *update)
+{
+    ev_timer_stop(net_loop, &update->hedge_timer);
+    update->running = false;
+    update->done_cb(update);
+}
+
+
+static bool check_response(ddns_attempt_t *attempt)
+{
+    ddns_update_t *update = attempt->update;
+    http_request_t *http = &attempt->http;
+
+    printf("response for %s: %s\n", update->domain, http->response);
+
+    for (size_t i = 0; i < http->length; i++) {
+        if (!isalnum(http->response[i])) {
+            http->response[i] = 0;
+            break;
+        }
+    }
+
+    snprintf(update->result, sizeof update->result, "%s", http->response);
+
+    // server-side problem, try another endpoint
+    if (strcmp(http->response, "911") == 0 ||
+        strcmp(http->response, "dnserr") == 0) {
+        return false;
+    }
+
+    // check response
+    if (strcmp(http->response, "good") == 0 ||
+        strcmp(http->response, "nochg") == 0) {
+        printf("Update of %s succeeded\n", update->domain);
+        update->accepted = true;
+        update->dns->ipaddr = update->ipaddr;
+        update->dns->ipaddr_set = update->ipaddr_set;
+        update->dns->ip6addr = update->ip6addr;
+        update->dns->ip6addr_set = update->ip6addr_set;
+    }
+    else {
+        printf("Update of %s failed\n", update->domain);
+    }
+
+    // consider the update completed even if the actual update failed,
+    // because at this level it doesn't make sense to retry it
+    update->completed = true;
+    return true;
+}
+
+
+static void attempt_done_cb(http_request_t *http)
+{
+    ddns_attempt_t *attempt = http->data;
+    ddns_update_t *update = attempt->update;
     bool success = false;
 
-    int n_addrs = 0;
-
-    if (if_stat->local_ipaddr_set) {
-        inet_ntop(AF_INET, &if_stat->local_ipaddr, ipaddrstr, sizeof ipaddrstr);
-        n_addrs++;
-    }
-    if (if_stat->local_ip6addr_set) {
-        inet_ntop(AF_INET6, &if_stat->local_ip6addr, ip6addrstr, sizeof ip6addrstr);
-        n_addrs++;
-    }
-
-    // build request URL
-    snprintf(urlbuffer, urllen, "%s?hostname=%s&myip=%s%s%s",
-             if_stat->url, if_stat->domain,
-             if_stat->local_ipaddr_set ? ipaddrstr : "",
-             n_addrs > 1 ? "," : "",
-             if_stat->local_ip6addr_set ? ip6addrstr : "");
-
-    if ((curl = curl_easy_init()) != NULL) {
-        CURLcode res;
-
-        curl_easy_setopt(curl, CURLOPT_URL, urlbuffer);
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, NLDDCD_USERAGENT);
-        curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
-        curl_easy_setopt(curl, CURLOPT_USERNAME, if_stat->login);
-        curl_easy_setopt(curl, CURLOPT_PASSWORD, if_stat->password);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_recv_cb);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
-        curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errorbuffer);
-
-        errorbuffer[0] = 0;
-        response->length = 0;
-
-        // perform HTTP request
-        res = curl_easy_perform(curl);
-        if (res == CURLE_OK) {
-            response->data[response->length] = 0;
-            printf("response: %s\n", response->data);
-
-            for (size_t i = 0; i < response->length; i++) {
-                if (!isalnum(response->data[i])) {
-                    response->data[i] = 0;
-                    break;
-                }
+    attempt->running = false;
+    update->active--;
+
+    if (http->success) {
+        success = check_response(attempt);
+    }
+    else {
+        fprintf(stderr, "%s: error: %s\n", attempt->endpoint->url, http->error);
+        snprintf(update->result, sizeof update->result, "%s", http->error_code);
+    }
+
+    end_probe(attempt);
+    record_attempt(attempt->endpoint, success, now() - attempt->start_time);
+
+    if (success) {
+        // cancel other attempts of this update
+        for (unsigned int i = 0; i < DDNS_MAX_ATTEMPTS; i++) {
+            ddns_attempt_t *other = &update->attempts[i];
+
+            if (other->running) {
+                // the slower attempt lost, remember how long it took so far
+                record_cancelled_attempt(other->endpoint, now() - other->start_time);
+                stop_attempt(other);
+            }
+        }
+        finish_update(update);
+    }
+    else if (update->active == 0) {
+        // fail over to the next endpoint immediately
+        if (!start_attempt(update)) {
+            finish_update(update);
+        }
+    }
+    else {
+        arm_hedge_timer(update);
+    }
+}
+
+
+static void hedge_cb(EV_P_ ev_timer *w, int revents)
+{
+    ddns_update_t *update = w->data;
+    endpoint_t *next = next_candidate(update);
+
+    if (next == NULL) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < DDNS_MAX_ATTEMPTS; i++) {
+        if (update->attempts[i].running) {
+            printf("%s is slow, also trying %s\n", update->attempts[i].endpoint->url, next->url);
+        }
+    }
+    start_attempt(update);
+}
+
+
+bool start_ddns_update(ddns_update_t *update)
+{
+    cancel_ddns_update(update);
+
+    update->completed = false;
+    update->accepted = false;
+    strcpy(update->result, "error");
+    update->active = 0;
+
+    ev_init(&update->hedge_timer, hedge_cb);
+    update->hedge_timer.data = update;
+
+    rank_endpoints(update);
+
+    if (!start_attempt(update)) {
+        return false;
+    }
+
+    update->running = true;
+    return true;
+}
+
+
+void cancel_ddns_update(ddns_update_t *update)
+{
+    if (update->running) {
+        for (unsigned int i = 0; i < DDNS_MAX_ATTEMPTS; i++) {
+            stop_attempt(&update->attempts[i]);
+        }
+        ev_timer_stop(net_loop, &update->hedge_timer);
+        update->running = false;
+    }
+}
+
+
+static void store_addresses(dns_status_t *dns, const struct addrinfo *result)
+{
+    dns->ipaddr_set = false;
+    dns->ip6addr_set = false;
+
+    for (const struct addrinfo *addr = result; addr != NULL; addr = addr->ai_next) {
+        switch (addr->ai_family) {
+        case AF_INET:
+            dns->ipaddr = ((struct sockaddr_in *)addr->ai_addr)->sin_addr;
+            dns->ipaddr_set = true;
+            break;
+        case AF_INET6:
+            dns->ip6addr = ((struct sockaddr_in6 *)addr->ai_addr)->sin6_addr;
+            dns->ip6addr_set = true;
+            break;
+        }
+    }
+
+    dns->resolved = true;
+}
+
+
+#ifdef HAVE_GETADDRINFO_A
+// runs in a thread started by getaddrinfo_a()
+static void lookup_notify(union sigval sv)
+{
+    ev_async_send(net_loop, &lookup_watcher);
+}
+
+
+static bool start_lookup(dns_lookup_t *lookup, dns_status_t *dns)
+{
+    struct gaicb *list[] = { &lookup->gai };
+    struct sigevent sev;
+    int ret;
+
+    snprintf(lookup->name, sizeof lookup->name, "%s", dns->domain);
+
+    // try to get A and AAAA records of domain
+    memset(&lookup->hints, 0, sizeof lookup->hints);
+    lookup->hints.ai_family = AF_UNSPEC;
+    lookup->hints.ai_socktype = SOCK_DGRAM;
+    memset(&lookup->gai, 0, sizeof lookup->gai);
+    lookup->gai.ar_name = lookup->name;
+    lookup->gai.ar_request = &lookup->hints;
+
+    memset(&sev, 0, sizeof sev);
+    sev.sigev_notify = SIGEV_THREAD;
+    sev.sigev_notify_function = lookup_notify;
+
+    // continued in lookup_cb()
+    ret = getaddrinfo_a(GAI_NOWAIT, list, 1, &sev);
+    if (ret != 0) {
+        fprintf(stderr, "%s: %s\n", dns->domain, gai_strerror(ret));
+        return false;
+    }
+
+    lookup->dns = dns;
+    lookup->busy = true;
+    dns->lookup = lookup;
+    return true;
+}
+
+
+static void start_waiting_lookup(dns_lookup_t *lookup)
+{
+    while (waiting_lookups != NULL) {
+        dns_status_t *dns = waiting_lookups;
+
+        waiting_lookups = dns->next;
+        if (start_lookup(lookup, dns)) {
+            return;
+        }
+
+        // report the failed lookup, the caller goes on without its result
+        dns->resolving = false;
+        dns->done_cb(dns);
+    }
+}
+
+
+static void lookup_cb(EV_P_ ev_async *w, int revents)
+{
+    for (int i = 0; i < DNS_MAX_LOOKUPS; i++) {
+        dns_lookup_t *lookup = &lookups[i];
+        dns_status_t *dns = NULL;
+
+        if (lookup->busy) {
+            struct addrinfo *result;
+            int ret = gai_error(&lookup->gai);
+
+            if (ret == EAI_INPROGRESS) {
+                continue;
             }
 
-            // check response
-            if (strcmp(response->data, "good") == 0 ||
-                strcmp(response->data, "nochg") == 0) {
-                printf("Update succeeded\n");
-                if (if_stat->local_ipaddr_set) {
-                    if_stat->dns_ipaddr = if_stat->local_ipaddr;
+            // dns is NULL if the lookup was cancelled
+            dns = lookup->dns;
+            result = lookup->gai.ar_result;
+            lookup->gai.ar_result = NULL;
+            lookup->dns = NULL;
+            lookup->busy = false;
+
+            if (dns != NULL) {
+                dns->lookup = NULL;
+                dns->resolving = false;
+                if (ret == 0) {
+                    store_addresses(dns, result);
                 }
-                if_stat->dns_ipaddr_set = if_stat->local_ipaddr_set;
-                if (if_stat->local_ip6addr_set) {
-                    if_stat->dns_ip6addr = if_stat->local_ip6addr;
+                else {
+                    fprintf(stderr, "%s: %s\n", lookup->name, gai_strerror(ret));
                 }
-                if_stat->dns_ip6addr_set = if_stat->local_ip6addr_set;
             }
-            else {
-                printf("Update failed\n");
+            if (result != NULL) {
+                freeaddrinfo(result);
             }
-
-            // return success here even if the actual update failed,
-            // because at this level it doesn't make sense to retry it
-            success = true;
-        }
-        else {
-            print_curl_error(res, errorbuffer);
         }
-        curl_easy_cleanup(curl);
-    }
 
-    free(response);
-    free(errorbuffer);
-    free(urlbuffer);
+        // also takes over lookups freed by cancel_resolve()
+        start_waiting_lookup(lookup);
 
-    return success;
+        if (dns != NULL) {
+            dns->done_cb(dns);
+        }
+    }
 }
+#endif
 
 
-void resolve_domain(interface_status_t *if_stat)
+bool resolve_domain(dns_status_t *dns, const char *domain, dns_done_cb_t done_cb, void *data)
 {
-    struct addrinfo hints, *result, *addr;
+#ifdef HAVE_GETADDRINFO_A
+    dns_status_t **tail;
+
+    dns->domain = domain;
+    dns->done_cb = done_cb;
+    dns->data = data;
+
+    // a lookup in progress reports to the new callback
+    if (dns->resolving) {
+        return true;
+    }
+
+    for (int i = 0; i < DNS_MAX_LOOKUPS; i++) {
+        if (!lookups[i].busy) {
+            dns->resolving = start_lookup(&lookups[i], dns);
+            return dns->resolving;
+        }
+    }
+
+    // started by lookup_cb() when a lookup has finished
+    for (tail = &waiting_lookups; *tail != NULL; tail = &(*tail)->next);
+    dns->next = NULL;
+    dns->lookup = NULL;
+    *tail = dns;
+    dns->resolving = true;
+    return true;
+#else
+    struct addrinfo hints, *result;
     int ret;
 
     memset(&hints, 0, sizeof hints);
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_DGRAM;
 
-    // try to get A and AAAA records of domain
-    ret = getaddrinfo(if_stat->domain, NULL, &hints, &result);
+    // without getaddrinfo_a(), domains are resolved synchronously and
+    // done_cb is not called
+    ret = getaddrinfo(domain, NULL, &hints, &result);
     if (ret == 0) {
-        if_stat->dns_ipaddr_set = false;
-        if_stat->dns_ip6addr_set = false;
-
-        for (addr = result; addr != NULL; addr = addr->ai_next) {
-            switch (addr->ai_family) {
-            case AF_INET:
-                if_stat->dns_ipaddr = ((struct sockaddr_in *)addr->ai_addr)->sin_addr;
-                if_stat->dns_ipaddr_set = true;
-                break;
-            case AF_INET6:
-                if_stat->dns_ip6addr = ((struct sockaddr_in6 *)addr->ai_addr)->sin6_addr;
-                if_stat->dns_ip6addr_set = true;
-                break;
-            }
-        }
+        store_addresses(dns, result);
+        freeaddrinfo(result);
+    }
+    else {
+        fprintf(stderr, "%s: %s\n", domain, gai_strerror(ret));
+    }
+    return false;
+#endif
+}
 
-        if_stat->resolved = true;
 
-        freeaddrinfo(result);
+void cancel_resolve(dns_status_t *dns)
+{
+#ifdef HAVE_GETADDRINFO_A
+    if (!dns->resolving) {
+        return;
+    }
+
+    if (dns->lookup != NULL) {
+        dns_lookup_t *lookup = dns->lookup;
+
+        // a lookup that is already running keeps its slot until it has
+        // finished, see lookup_cb(); gai_error() of a cancelled one stays
+        // EAI_INPROGRESS, so the slot is freed here
+        lookup->dns = NULL;
+        if (gai_cancel(&lookup->gai) == EAI_CANCELED) {
+            lookup->busy = false;
+            ev_async_send(net_loop, &lookup_watcher);
+        }
+        dns->lookup = NULL;
     }
     else {
-        fprintf(stderr, "%s: %s\n", if_stat->domain, gai_strerror(ret));
+        for (dns_status_t **p = &waiting_lookups; *p != NULL; p = &(*p)->next) {
+            if (*p == dns) {
+                *p = dns->next;
+                break;
+            }
+        }
     }
+
+    dns->resolving = false;
+#endif
 }
 
 
-bool init_net(void)
+bool init_net(EV_P)
 {
-    return curl_global_init(CURL_GLOBAL_DEFAULT) == CURLE_OK;
+    net_loop = EV_A;
+
+#ifdef HAVE_GETADDRINFO_A
+    // must not keep the loop alive by itself
+    ev_async_init(&lookup_watcher, lookup_cb);
+    ev_async_start(EV_A_ &lookup_watcher);
+    ev_unref(EV_A);
+#endif
+
+    return http_init(EV_A);
 }
 
 
 void cleanup_net(void)
 {
-    curl_global_cleanup();
+    while (endpoints != NULL) {
+        endpoint_t *endpoint = endpoints;
+
+        endpoints = endpoint->next;
+        free(endpoint->url);
+        free(endpoint);
+    }
+
+#ifdef HAVE_GETADDRINFO_A
+    // wait for lookups that could not be cancelled
+    for (int i = 0; i < DNS_MAX_LOOKUPS; i++) {
+        dns_lookup_t *lookup = &lookups[i];
+        const struct gaicb *list[] = { &lookup->gai };
+
+        if (!lookup->busy) {
+            continue;
+        }
+        if (gai_cancel(&lookup->gai) != EAI_CANCELED) {
+            while (gai_error(&lookup->gai) == EAI_INPROGRESS) {
+                gai_suspend(list, 1, NULL);
+            }
+            if (lookup->gai.ar_result != NULL) {
+                freeaddrinfo(lookup->gai.ar_result);
+                lookup->gai.ar_result = NULL;
+            }
+        }
+        lookup->busy = false;
+    }
+    waiting_lookups = NULL;
+
+    ev_ref(net_loop);
+    ev_async_stop(net_loop, &lookup_watcher);
+#endif
+
+    http_cleanup();
 }
@@ -20,12 +20,85 @@
 #define _NLDDCD_NET_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <netinet/in.h>
 
-#include "conf.h"
+#include <ev.h>
 
-bool perform_ddns_update(interface_status_t *if_stat);
-void resolve_domain(interface_status_t *if_stat);
-bool init_net(void);
+#include "http.h"
+
+#define DDNS_MAX_URLS      8        // per update
+#define DDNS_MAX_ATTEMPTS  2        // concurrent attempts per update
+#define DDNS_URL_SIZE      512      // including the query string
+#define DNS_MAX_LOOKUPS    8        // concurrent lookups, more are queued
+
+typedef struct dns_status dns_status_t;
+typedef void (*dns_done_cb_t)(dns_status_t *dns);
+
+struct dns_status {
+    struct in_addr  ipaddr;
+    struct in6_addr ip6addr;
+    bool ipaddr_set;
+    bool ip6addr_set;
+    bool resolved;
+
+    // private to net.c, set by resolve_domain()
+    bool resolving;
+    const char *domain;
+    dns_done_cb_t done_cb;              // called from the event loop
+    void *data;                         // for the caller
+    struct dns_lookup *lookup;          // NULL while queued
+    struct dns_status *next;            // queue of waiting lookups
+};
+
+typedef struct ddns_update ddns_update_t;
+typedef void (*ddns_done_cb_t)(ddns_update_t *update);
+
+typedef struct ddns_attempt {
+    http_request_t http;
+    ddns_update_t *update;
+    struct endpoint *endpoint;
+    double start_time;
+    bool running;
+    char url[DDNS_URL_SIZE];
+} ddns_attempt_t;
+
+struct ddns_update {
+    const char **urls;                  // endpoints in configured order
+    unsigned int num_urls;
+    double timeout;                     // per attempt, in seconds
+    const char *login;
+    const char *password;
+    const char *domain;
+    struct in_addr ipaddr;
+    struct in6_addr ip6addr;
+    bool ipaddr_set;                    // to be published
+    bool ip6addr_set;                   // to be published
+    dns_status_t *dns;                  // updated on success
+    ddns_done_cb_t done_cb;             // called from the event loop
+    void *data;                         // for the caller
+    char result[16];                    // response code or error
+    bool completed;
+    bool accepted;
+
+    // private to net.c, no memory is allocated per update
+    bool running;
+    struct endpoint *candidates[DDNS_MAX_URLS];     // ordered by preference
+    unsigned int num_candidates;
+    unsigned int next_candidate;
+    bool all_suspended;                 // candidates are tried anyway
+    unsigned int active;                // attempts in flight
+    double hedge_time;                  // start of next hedged attempt
+    ev_timer hedge_timer;
+    ddns_attempt_t attempts[DDNS_MAX_ATTEMPTS];
+};
+
+
+bool start_ddns_update(ddns_update_t *update);
+void cancel_ddns_update(ddns_update_t *update);
+bool resolve_domain(dns_status_t *dns, const char *domain, dns_done_cb_t done_cb, void *data);
+void cancel_resolve(dns_status_t *dns);
+bool init_net(EV_P);
 void cleanup_net(void);
 
 #endif
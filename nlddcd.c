@@ -37,10 +37,17 @@
 
 #include "conf.h"
 #include "net.h"
+#include "status.h"
+#ifdef HAVE_LIBURING
+#include "uring.h"
+#endif
 
 
 #define DEFAULT_CONF_FILE SYSCONFDIR "/nlddcd.conf"
 
+#define SETTLE_DELAY  5.0     // merge address changes within this time
+#define DAD_WAIT_MAX  10.0    // hold back updates while DAD is running
+
 #define container_of(ptr, type, member) ({                      \
         const typeof( ((type *)0)->member ) *__mptr = (ptr);    \
         (type *)( (char *)__mptr - offsetof(type, member) );})
@@ -80,49 +87,229 @@ void version(void)
 }
 
 
-void timeout_cb(EV_P_ ev_timer *w, int revents)
+void derive_host_addr(host_status_t *host, const struct in6_addr *prefix)
 {
-    bool update_required = false;
-    interface_status_t *if_stat = container_of(w, interface_status_t, timeout);
+    // upper 64 bits from the delegated prefix, lower 64 bits from the iid
+    memcpy(host->ip6addr.s6_addr, prefix->s6_addr, 8);
+    memcpy(host->ip6addr.s6_addr + 8, host->iid.s6_addr + 8, 8);
+}
 
-    ev_timer_stop(EV_A_ w);
 
-    if (!if_stat->resolved) {
-        resolve_domain(if_stat);
+void record_update_result(target_status_t *target, const ddns_update_t *update)
+{
+    // derived hosts keep their own result
+    if (update == &target->update) {
+        target->last_update = time(NULL);
+        strcpy(target->last_result, update->result);
+    }
+    else {
+        host_status_t *host = container_of(update, host_status_t, update);
+
+        host->last_update = time(NULL);
+        strcpy(host->last_result, update->result);
     }
 
+    // a retry covers all updates of the target
+    if (!update->completed && !ev_is_active(&target->retry)) {
+        printf("Retrying update of %s in 30 seconds ...\n", target->domain);
+        target->retry.repeat = 30.0;
+        ev_timer_again(EV_DEFAULT_ &target->retry);
+        target->retry_time = time(NULL) + 30;
+    }
+}
+
+
+void update_done_cb(ddns_update_t *update)
+{
+    target_status_t *target = update->data;
+
+    record_update_result(target, update);
+    publish_status(target->if_stat);
+}
+
+
+void start_update(target_status_t *target, ddns_update_t *update, const char *domain)
+{
+    update->urls = target->urls;
+    update->num_urls = target->num_urls;
+    update->timeout = target->request_timeout;
+    update->login = target->login;
+    update->password = target->password;
+    update->domain = domain;
+    update->done_cb = update_done_cb;
+    update->data = target;
+
+    // runs in the background, see update_done_cb()
+    if (!start_ddns_update(update)) {
+        record_update_result(target, update);
+    }
+}
+
+
+void check_target(interface_status_t *if_stat, target_status_t *target)
+{
+    bool update_required = false;
+
     // compare local and remote addresses
-    if ((if_stat->local_ipaddr_set != if_stat->dns_ipaddr_set) ||
-        (if_stat->local_ipaddr_set == true && /*if_stat->dns_ipaddr_set == true &&*/
-         if_stat->local_ipaddr.s_addr != if_stat->dns_ipaddr.s_addr)) {
+    if ((if_stat->local_ipaddr_set != target->dns.ipaddr_set) ||
+        (if_stat->local_ipaddr_set == true && /*target->dns.ipaddr_set == true &&*/
+         if_stat->local_ipaddr.s_addr != target->dns.ipaddr.s_addr)) {
         printf("IPv4 address of interface %s differs from address of %s\n",
-               if_stat->ifname, if_stat->domain);
+               if_stat->ifname, target->domain);
         update_required = true;
     }
-    if ((if_stat->local_ip6addr_set != if_stat->dns_ip6addr_set) ||
-        (if_stat->local_ip6addr_set == true && /*if_stat->dns_ip6addr_set == true &&*/
-         memcmp(if_stat->local_ip6addr.s6_addr, if_stat->dns_ip6addr.s6_addr, 16) != 0)) {
+    if ((if_stat->local_ip6addr_set != target->dns.ip6addr_set) ||
+        (if_stat->local_ip6addr_set == true && /*target->dns.ip6addr_set == true &&*/
+         memcmp(if_stat->local_ip6addr.s6_addr, target->dns.ip6addr.s6_addr, 16) != 0)) {
         printf("IPv6 address of interface %s differs from address of %s\n",
-               if_stat->ifname, if_stat->domain);
+               if_stat->ifname, target->domain);
         update_required = true;
     }
 
     if (update_required) {
         if (if_stat->local_ipaddr_set || if_stat->local_ip6addr_set) {
-            if (!perform_ddns_update(if_stat)) {
-                printf("Retrying in 30 seconds ...\n");
-                if_stat->timeout.repeat = 30.0;
-                ev_timer_again(EV_DEFAULT_ &if_stat->timeout);
-            }
+            ddns_update_t *update = &target->update;
+
+            update->ipaddr = if_stat->local_ipaddr;
+            update->ipaddr_set = if_stat->local_ipaddr_set;
+            update->ip6addr = if_stat->local_ip6addr;
+            update->ip6addr_set = if_stat->local_ip6addr_set;
+            update->dns = &target->dns;
+
+            start_update(target, update, target->domain);
         }
         else {
-            printf("No addresses configured on interface %s, skipping update\n",
-                   if_stat->ifname);
+            printf("No addresses configured on interface %s, skipping update of %s\n",
+                   if_stat->ifname, target->domain);
         }
     }
 }
 
 
+void check_host(interface_status_t *if_stat, target_status_t *target, host_status_t *host)
+{
+    // derived hosts follow the IPv6 prefix of the interface
+    if (!if_stat->local_ip6addr_set) {
+        return;
+    }
+
+    derive_host_addr(host, &if_stat->local_ip6addr);
+
+    if (!host->dns.ip6addr_set ||
+        memcmp(host->ip6addr.s6_addr, host->dns.ip6addr.s6_addr, 16) != 0) {
+        ddns_update_t *update = &host->update;
+
+        printf("IPv6 address of %s differs from prefix of interface %s\n",
+               host->domain, if_stat->ifname);
+
+        update->ipaddr_set = false;
+        update->ip6addr = host->ip6addr;
+        update->ip6addr_set = true;
+        update->dns = &host->dns;
+
+        start_update(target, update, host->domain);
+    }
+}
+
+
+void resolve_done_cb(dns_status_t *dns)
+{
+    target_status_t *target = dns->data;
+
+    // the interface timer is pending (new address or DAD), it will
+    // compare all addresses again anyway
+    if (ev_is_active(&target->if_stat->timeout)) {
+        return;
+    }
+
+    if (dns == &target->dns) {
+        check_target(target->if_stat, target);
+    }
+    else {
+        check_host(target->if_stat, target, container_of(dns, host_status_t, dns));
+    }
+    publish_status(target->if_stat);
+}
+
+
+void prepare_target_updates(interface_status_t *if_stat, target_status_t *target)
+{
+    // published addresses are looked up once, in the background; the
+    // comparison then continues in resolve_done_cb()
+    if (target->dns.resolved ||
+        !resolve_domain(&target->dns, target->domain, resolve_done_cb, target)) {
+        check_target(if_stat, target);
+    }
+
+    for (host_status_t *host = target->hosts; host != NULL; host = host->next) {
+        if (host->dns.resolved ||
+            !resolve_domain(&host->dns, host->domain, resolve_done_cb, target)) {
+            check_host(if_stat, target, host);
+        }
+    }
+}
+
+
+void update_targets(interface_status_t *if_stat, target_status_t *only)
+{
+    // wait until duplicate address detection has finished; the interface
+    // timer then updates all targets, including a retried one
+    if (if_stat->tentative_ip6addr_set &&
+        ev_now(EV_DEFAULT) - if_stat->tentative_since < DAD_WAIT_MAX) {
+        printf("Waiting for DAD to complete on interface %s\n", if_stat->ifname);
+        if_stat->timeout.repeat = 1.0;
+        ev_timer_again(EV_DEFAULT_ &if_stat->timeout);
+
+        // a held back retry is now due with the interface timer
+        if (only != NULL) {
+            only->retry_time = time(NULL) + (time_t)if_stat->timeout.repeat;
+            publish_status(if_stat);
+        }
+        return;
+    }
+
+    for (target_status_t *target = if_stat->targets; target != NULL; target = target->next) {
+        if (only != NULL && target != only) {
+            continue;
+        }
+
+        ev_timer_stop(EV_DEFAULT_ &target->retry);
+        target->retry_time = 0;
+
+        // outdated updates still in progress are replaced
+        cancel_ddns_update(&target->update);
+        for (host_status_t *host = target->hosts; host != NULL; host = host->next) {
+            cancel_ddns_update(&host->update);
+        }
+
+        prepare_target_updates(if_stat, target);
+    }
+
+    // all updates run concurrently, each result is published when it arrives
+    publish_status(if_stat);
+}
+
+
+void timeout_cb(EV_P_ ev_timer *w, int revents)
+{
+    interface_status_t *if_stat = container_of(w, interface_status_t, timeout);
+
+    ev_timer_stop(EV_A_ w);
+
+    update_targets(if_stat, NULL);
+}
+
+
+void retry_cb(EV_P_ ev_timer *w, int revents)
+{
+    target_status_t *target = container_of(w, target_status_t, retry);
+
+    ev_timer_stop(EV_A_ w);
+
+    update_targets(target->if_stat, target);
+}
+
+
 size_t af_addr_size(unsigned char family)
 {
     switch (family) {
@@ -136,17 +323,205 @@ size_t af_addr_size(unsigned char family)
 }
 
 
+void schedule_update(interface_status_t *if_stat)
+{
+    ev_timer *timer = &if_stat->timeout;
+
+    // don't postpone an update that is already due soon, so that
+    // changes arriving close together are merged into a single update
+    if (!ev_is_active(timer) || ev_timer_remaining(EV_DEFAULT_ timer) > SETTLE_DELAY) {
+        timer->repeat = SETTLE_DELAY;
+        ev_timer_again(EV_DEFAULT_ timer);
+    }
+}
+
+
+bool address_usable(unsigned int flags, const struct ifa_cacheinfo *cacheinfo)
+{
+    // only consider addresses that passed DAD and are still preferred
+    if (flags & (IFA_F_TENTATIVE | IFA_F_DADFAILED | IFA_F_DEPRECATED)) {
+        return false;
+    }
+    return cacheinfo == NULL || cacheinfo->ifa_prefered > 0;
+}
+
+
+void update_tentative_addr(interface_status_t *if_stat, const struct nlmsghdr *nlh,
+                           const void *addr, unsigned int flags)
+{
+    char addrstr[INET6_ADDRSTRLEN];
+    bool tentative = nlh->nlmsg_type == RTM_NEWADDR &&
+                     (flags & (IFA_F_TENTATIVE | IFA_F_DADFAILED)) == IFA_F_TENTATIVE;
+
+    if (tentative) {
+        if (!if_stat->tentative_ip6addr_set ||
+            memcmp(&if_stat->tentative_ip6addr, addr, sizeof(struct in6_addr)) != 0) {
+            printf("address on %s is tentative: %s\n",
+                   if_stat->ifname, inet_ntop(AF_INET6, addr, addrstr, sizeof addrstr));
+            memcpy(&if_stat->tentative_ip6addr, addr, sizeof(struct in6_addr));
+            if_stat->tentative_ip6addr_set = true;
+            if_stat->tentative_since = ev_now(EV_DEFAULT);
+        }
+    }
+    else if (if_stat->tentative_ip6addr_set &&
+             memcmp(&if_stat->tentative_ip6addr, addr, sizeof(struct in6_addr)) == 0) {
+        if (flags & IFA_F_DADFAILED) {
+            printf("DAD failed on %s: %s\n",
+                   if_stat->ifname, inet_ntop(AF_INET6, addr, addrstr, sizeof addrstr));
+        }
+        if_stat->tentative_ip6addr_set = false;
+    }
+}
+
+
+void track_addr(interface_status_t *if_stat, const struct nlmsghdr *nlh,
+                unsigned char family, const void *addr, bool usable)
+{
+    size_t addrsize = af_addr_size(family);
+    known_addr_t *known = NULL;
+
+    for (unsigned int i = 0; i < if_stat->num_known_addrs; i++) {
+        if (if_stat->known_addrs[i].family == family &&
+            memcmp(&if_stat->known_addrs[i].addr, addr, addrsize) == 0) {
+            known = &if_stat->known_addrs[i];
+            break;
+        }
+    }
+
+    if (nlh->nlmsg_type == RTM_DELADDR) {
+        if (known != NULL) {
+            *known = if_stat->known_addrs[--if_stat->num_known_addrs];
+        }
+        return;
+    }
+
+    if (known == NULL) {
+        if (if_stat->num_known_addrs == MAX_KNOWN_ADDRS) {
+            return;
+        }
+        known = &if_stat->known_addrs[if_stat->num_known_addrs++];
+        memset(known, 0, sizeof *known);
+        known->family = family;
+        memcpy(&known->addr, addr, addrsize);
+    }
+    known->usable = usable;
+}
+
+
+const void *find_usable_addr(const interface_status_t *if_stat, unsigned char family)
+{
+    for (unsigned int i = 0; i < if_stat->num_known_addrs; i++) {
+        if (if_stat->known_addrs[i].family == family && if_stat->known_addrs[i].usable) {
+            return &if_stat->known_addrs[i].addr;
+        }
+    }
+    return NULL;
+}
+
+
+void update_local_addr(interface_status_t *if_stat, const struct nlmsghdr *nlh,
+                       const struct ifaddrmsg *ifa, const void *addr, bool usable)
+{
+    char addrstr[INET6_ADDRSTRLEN];
+    void *local_addr = NULL;
+    bool *local_addr_set = NULL;
+    size_t addrsize = af_addr_size(ifa->ifa_family);
+
+    switch (ifa->ifa_family) {
+    case AF_INET:
+        local_addr = &if_stat->local_ipaddr;
+        local_addr_set = &if_stat->local_ipaddr_set;
+        break;
+    case AF_INET6:
+        local_addr = &if_stat->local_ip6addr;
+        local_addr_set = &if_stat->local_ip6addr_set;
+        break;
+    default:
+        return;
+    }
+
+    if (nlh->nlmsg_type == RTM_NEWADDR && usable) {
+        if (!*local_addr_set || memcmp(local_addr, addr, addrsize) != 0) {
+
+            printf("detected address change on %s: %s\n",
+                   if_stat->ifname, inet_ntop(ifa->ifa_family, addr, addrstr, sizeof addrstr));
+            memcpy(local_addr, addr, addrsize);
+            *local_addr_set = true;
+
+            schedule_update(if_stat);
+            publish_status(if_stat);
+        }
+    }
+    else {
+        // removed, or no longer usable (DAD failed, deprecated)
+        if (*local_addr_set && memcmp(local_addr, addr, addrsize) == 0) {
+            const void *other = find_usable_addr(if_stat, ifa->ifa_family);
+
+            printf("address %s from %s: %s\n",
+                   (nlh->nlmsg_type == RTM_DELADDR) ? "removed" : "no longer usable",
+                   if_stat->ifname, inet_ntop(ifa->ifa_family, addr, addrstr, sizeof addrstr));
+
+            // publish another preferred address of the interface, if any
+            if (other != NULL) {
+                printf("falling back to address on %s: %s\n",
+                       if_stat->ifname, inet_ntop(ifa->ifa_family, other, addrstr, sizeof addrstr));
+                memcpy(local_addr, other, addrsize);
+            }
+            else {
+                memset(local_addr, 0, addrsize);
+                *local_addr_set = false;
+            }
+
+            schedule_update(if_stat);
+            publish_status(if_stat);
+        }
+    }
+}
+
+
+void remove_interface(interface_status_t *if_stat)
+{
+    interface_status_t **p;
+
+    printf("interface %s is gone, forgetting it\n", if_stat->ifname);
+
+    for (p = &if_stat_head; *p != NULL; p = &(*p)->next) {
+        if (*p == if_stat) {
+            *p = if_stat->next;
+            break;
+        }
+    }
+
+    ev_timer_stop(EV_DEFAULT_ &if_stat->timeout);
+    for (target_status_t *target = if_stat->targets; target != NULL; target = target->next) {
+        ev_timer_stop(EV_DEFAULT_ &target->retry);
+        cancel_resolve(&target->dns);
+        cancel_ddns_update(&target->update);
+        for (host_status_t *host = target->hosts; host != NULL; host = host->next) {
+            cancel_resolve(&host->dns);
+            cancel_ddns_update(&host->update);
+        }
+    }
+
+    unpublish_status(if_stat);
+    free_interface_status(if_stat);
+}
+
+
 void parse_addr_msg(const struct nlmsghdr *nlh)
 {
     char ifname[IF_NAMESIZE];
-    char addrstr[INET6_ADDRSTRLEN];
     unsigned int flags;
     const void *addr = NULL;
+    const struct ifa_cacheinfo *cacheinfo = NULL;
     const struct nlattr *attr;
     const struct ifaddrmsg *ifa = mnl_nlmsg_get_payload(nlh);
     size_t addrsize = af_addr_size(ifa->ifa_family);
 
-    if_indextoname(ifa->ifa_index, ifname);
+    // interface already gone, RTM_DELLINK takes care of it
+    if (if_indextoname(ifa->ifa_index, ifname) == NULL) {
+        return;
+    }
     flags = ifa->ifa_flags;
 
     mnl_attr_for_each(attr, nlh, sizeof *ifa) {
@@ -168,59 +543,92 @@ void parse_addr_msg(const struct nlmsghdr *nlh)
                     flags = mnl_attr_get_u32(attr);
                 }
             }
+            if (type == IFA_CACHEINFO) {
+                if (mnl_attr_validate2(attr, MNL_TYPE_BINARY, sizeof *cacheinfo) >= 0) {
+                    cacheinfo = mnl_attr_get_payload(attr);
+                }
+            }
         }
     }
 
     // found non-temporary global address?
     if (addr != NULL && ifa->ifa_scope == RT_SCOPE_UNIVERSE && (flags & IFA_F_TEMPORARY) == 0) {
         interface_status_t *if_stat;
+        interface_status_t *gone = NULL;
+        bool found = false;
+        bool usable = address_usable(flags, cacheinfo);
 
         for (if_stat = if_stat_head; if_stat != NULL; if_stat = if_stat->next) {
             if (strncmp(if_stat->ifname, ifname, IF_NAMESIZE) == 0) {
-                void *local_addr = NULL;
-                bool *local_addr_set = NULL;
-
-                switch (ifa->ifa_family) {
-                case AF_INET:
-                    local_addr = &if_stat->local_ipaddr;
-                    local_addr_set = &if_stat->local_ipaddr_set;
-                    break;
-                case AF_INET6:
-                    local_addr = &if_stat->local_ip6addr;
-                    local_addr_set = &if_stat->local_ip6addr_set;
-                    break;
-                default:
-                    continue;
+                if (ifa->ifa_family == AF_INET6) {
+                    update_tentative_addr(if_stat, nlh, addr, flags);
                 }
+                track_addr(if_stat, nlh, ifa->ifa_family, addr, usable);
+                update_local_addr(if_stat, nlh, ifa, addr, usable);
+                found = true;
 
-                switch (nlh->nlmsg_type) {
-                case RTM_NEWADDR:
-                    if (!*local_addr_set || memcmp(local_addr, addr, addrsize) != 0) {
-
-                        printf("detected address change on %s: %s\n",
-                               ifname, inet_ntop(ifa->ifa_family, addr, addrstr, sizeof addrstr));
-                        memcpy(local_addr, addr, addrsize);
-                        *local_addr_set = true;
-
-                        if_stat->timeout.repeat = 5.0;
-                        ev_timer_again(EV_DEFAULT_ &if_stat->timeout);
-                    }
-                    break;
-
-                case RTM_DELADDR:
-                    if (*local_addr_set && memcmp(local_addr, addr, addrsize) == 0) {
-                        printf("address removed from %s: %s\n",
-                               ifname, inet_ntop(ifa->ifa_family, addr, addrstr, sizeof addrstr));
-                        memset(local_addr, 0, addrsize);
-                        *local_addr_set = false;
-
-                        if_stat->timeout.repeat = 5.0;
-                        ev_timer_again(EV_DEFAULT_ &if_stat->timeout);
-                    }
-                    break;
+                // interfaces matched by a pattern are dropped with their last address
+                if (if_stat->dynamic && if_stat->num_known_addrs == 0) {
+                    gone = if_stat;
                 }
             }
         }
+
+        if (gone != NULL) {
+            remove_interface(gone);
+        }
+
+        // not configured explicitly, but maybe matched by a pattern section
+        if (!found && nlh->nlmsg_type == RTM_NEWADDR &&
+            (if_stat = match_interface_pattern(ifname)) != NULL) {
+            printf("interface %s matched pattern, publishing as", if_stat->ifname);
+            for (target_status_t *target = if_stat->targets; target != NULL;
+                 target = target->next) {
+                printf(" %s", target->domain);
+            }
+            printf("\n");
+
+            if_stat->next = if_stat_head;
+            if_stat_head = if_stat;
+
+            if (ifa->ifa_family == AF_INET6) {
+                update_tentative_addr(if_stat, nlh, addr, flags);
+            }
+            track_addr(if_stat, nlh, ifa->ifa_family, addr, usable);
+            update_local_addr(if_stat, nlh, ifa, addr, usable);
+        }
+    }
+}
+
+
+void parse_link_msg(const struct nlmsghdr *nlh)
+{
+    const char *ifname = NULL;
+    const struct nlattr *attr;
+    const struct ifinfomsg *ifi = mnl_nlmsg_get_payload(nlh);
+
+    // sent when a port leaves a bridge, the interface itself stays
+    if (ifi->ifi_family == AF_BRIDGE) {
+        return;
+    }
+
+    mnl_attr_for_each(attr, nlh, sizeof *ifi) {
+        if (mnl_attr_get_type(attr) == IFLA_IFNAME &&
+            mnl_attr_validate(attr, MNL_TYPE_NUL_STRING) >= 0) {
+            ifname = mnl_attr_get_str(attr);
+        }
+    }
+
+    if (ifname == NULL) {
+        return;
+    }
+
+    // free interfaces that were created from a pattern section
+    for (interface_status_t *if_stat = if_stat_head; if_stat != NULL; if_stat = if_stat->next) {
+        if (if_stat->dynamic && strncmp(if_stat->ifname, ifname, IF_NAMESIZE) == 0) {
+            remove_interface(if_stat);
+            break;
+        }
     }
 }
 
@@ -232,6 +640,9 @@ int nl_msg_cb(const struct nlmsghdr *nlh, void *data)
     case RTM_DELADDR:
         parse_addr_msg(nlh);
         break;
+    case RTM_DELLINK:
+        parse_link_msg(nlh);
+        break;
     }
 
     return MNL_CB_OK;
@@ -241,6 +652,12 @@ int nl_msg_cb(const struct nlmsghdr *nlh, void *data)
 unsigned int seq, portid;
 
 
+void process_nl_msg(const void *buf, size_t len)
+{
+    mnl_cb_run(buf, len, 0, 0, nl_msg_cb, NULL);
+}
+
+
 void receive_nl_msg(struct mnl_socket *nl)
 {
     char buf[MNL_SOCKET_BUFFER_SIZE];
@@ -249,7 +666,7 @@ void receive_nl_msg(struct mnl_socket *nl)
     len = mnl_socket_recvfrom(nl, buf, sizeof buf);
 
     if (len > 0) {
-        mnl_cb_run(buf, len, 0, 0, nl_msg_cb, NULL);
+        process_nl_msg(buf, len);
     }
 }
 
@@ -278,6 +695,7 @@ void request_addr_dump(struct mnl_socket *nl)
 int join_mcast_groups(struct mnl_socket *nl)
 {
     int groups[] = {
+        RTNLGRP_LINK,
         RTNLGRP_IPV4_IFADDR,
         RTNLGRP_IPV6_IFADDR,
     };
@@ -338,6 +756,12 @@ void nl_cb(EV_P_ ev_io *w, int revents)
 }
 
 
+void start_nl_watcher(EV_P)
+{
+    ev_io_start(EV_A_ &nl_watcher);
+}
+
+
 void stop_cb(EV_P_ ev_signal *w, int revents)
 {
     ev_break(EV_A_ EVBREAK_ALL);
@@ -380,16 +804,28 @@ int main(int argc, char *argv[])
     // enforce line-buffered stdout
     setlinebuf(stdout);
 
-    if (init_net()) {
+    if (init_net(loop)) {
         // read configuration
         if (read_config(cfgfile, &if_stat_head)) {
 
+            // export status of configured interfaces
+            if (init_status()) {
+                for (interface_status_t *if_stat = if_stat_head; if_stat != NULL;
+                     if_stat = if_stat->next) {
+                    publish_status(if_stat);
+                }
+            }
+
             // open netlink
             if ((nl = nl_open()) != NULL) {
                 // init event loop
                 ev_io_init(&nl_watcher, nl_cb, mnl_socket_get_fd(nl), EV_READ);
                 nl_watcher.data = nl;
-                ev_io_start(loop, &nl_watcher);
+#ifdef HAVE_LIBURING
+                // prefer io_uring, fall back to libev if unavailable
+                if (!init_uring(loop, mnl_socket_get_fd(nl), process_nl_msg, start_nl_watcher))
+#endif
+                    start_nl_watcher(loop);
 
                 ev_signal_init(&stop_watcher, stop_cb, SIGTERM);
                 ev_signal_start(loop, &stop_watcher);
@@ -400,9 +836,14 @@ int main(int argc, char *argv[])
                 ev_run(loop, 0);
                 ret = EXIT_SUCCESS;
 
+#ifdef HAVE_LIBURING
+                cleanup_uring(loop);
+#endif
+
                 mnl_socket_close(nl);
             }
 
+            cleanup_status();
             cleanup_config();
         }
 
@@ -0,0 +1,218 @@
+/*
+  Copyright (C) 2017 Christof Efkemann.
+  This file is part of nlddcd.
+
+  nlddcd is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  nlddcd is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with nlddcd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "status.h"
+
+
+void syntax(void)
+{
+    printf("Usage: nlddcdctl [OPTIONS] status\n");
+}
+
+
+void help(void)
+{
+    syntax();
+    printf("\n"
+           "Show the status of a running " PACKAGE_NAME " daemon.\n"
+           "\n"
+           "Options:\n"
+           "  -h, --help              Show this help message and exit.\n"
+           "  -v, --version           Show version info and exit.\n");
+}
+
+
+void version(void)
+{
+    printf("nlddcdctl (" PACKAGE_STRING ")\n"
+           "Copyright (C) 2017 Christof Efkemann.\n"
+           "License GPLv3+: GNU GPL version 3 or later <http://gnu.org/licenses/gpl.html>.\n"
+           "This is free software: you are free to change and redistribute it.\n"
+           "There is NO WARRANTY, to the extent permitted by law.\n");
+}
+
+
+const status_table_t *map_status_table(size_t *size)
+{
+    int fd;
+    struct stat st;
+    const status_table_t *table;
+
+    fd = shm_open(STATUS_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < sizeof *table) {
+        fprintf(stderr, "status table has unexpected size\n");
+        close(fd);
+        return NULL;
+    }
+
+    // the daemon may grow the table later, only this part is accessed
+    *size = st.st_size;
+    table = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (table == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+
+    if (__atomic_load_n(&table->magic, __ATOMIC_ACQUIRE) != STATUS_MAGIC ||
+        table->version != STATUS_VERSION ||
+        table->entry_size != sizeof(status_entry_t)) {
+        fprintf(stderr, "status table has incompatible format\n");
+        munmap((void *)table, *size);
+        return NULL;
+    }
+
+    return table;
+}
+
+
+void read_entry(const status_entry_t *entry, status_entry_t *snapshot)
+{
+    uint32_t seq;
+
+    // retry until a consistent copy has been obtained
+    do {
+        seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        memcpy(snapshot, entry, sizeof *snapshot);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) != 0 || __atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq);
+}
+
+
+const char *format_time(int64_t t, char *buf, size_t len)
+{
+    time_t tt = t;
+    struct tm tm;
+
+    if (t == 0) {
+        return "-";
+    }
+    strftime(buf, len, "%Y-%m-%d %H:%M:%S", localtime_r(&tt, &tm));
+    return buf;
+}
+
+
+void print_entry(const status_entry_t *entry)
+{
+    char addrstr[INET6_ADDRSTRLEN];
+    char timestr[32];
+    bool in_sync = true;
+
+    if ((entry->flags & STATUS_LOCAL_IPADDR_SET) != 0) {
+        in_sync = in_sync && (entry->flags & STATUS_DNS_IPADDR_SET) != 0 &&
+                  entry->local_ipaddr.s_addr == entry->dns_ipaddr.s_addr;
+    }
+    if ((entry->flags & STATUS_LOCAL_IP6ADDR_SET) != 0) {
+        in_sync = in_sync && (entry->flags & STATUS_DNS_IP6ADDR_SET) != 0 &&
+                  memcmp(&entry->local_ip6addr, &entry->dns_ip6addr, 16) == 0;
+    }
+
+    printf("%s (%s%s): %s\n", entry->ifname, entry->domain,
+           (entry->flags & STATUS_HOST) ? ", derived host" : "",
+           in_sync ? "in sync" : "out of sync");
+    printf("  local IPv4:     %s\n", (entry->flags & STATUS_LOCAL_IPADDR_SET) ?
+           inet_ntop(AF_INET, &entry->local_ipaddr, addrstr, sizeof addrstr) : "-");
+    printf("  published IPv4: %s\n", (entry->flags & STATUS_DNS_IPADDR_SET) ?
+           inet_ntop(AF_INET, &entry->dns_ipaddr, addrstr, sizeof addrstr) : "-");
+    printf("  local IPv6:     %s\n", (entry->flags & STATUS_LOCAL_IP6ADDR_SET) ?
+           inet_ntop(AF_INET6, &entry->local_ip6addr, addrstr, sizeof addrstr) : "-");
+    printf("  published IPv6: %s\n", (entry->flags & STATUS_DNS_IP6ADDR_SET) ?
+           inet_ntop(AF_INET6, &entry->dns_ip6addr, addrstr, sizeof addrstr) : "-");
+    printf("  last update:    %s", format_time(entry->last_update, timestr, sizeof timestr));
+    printf(" (%s)\n", entry->last_result[0] != 0 ? entry->last_result : "-");
+    printf("  next retry:     %s\n", format_time((entry->flags & STATUS_RETRY_PENDING) ?
+                                                 entry->retry_time : 0, timestr, sizeof timestr));
+}
+
+
+int show_status(void)
+{
+    const status_table_t *table;
+    size_t size;
+    uint32_t num_entries, max_entries;
+    status_entry_t snapshot;
+
+    if ((table = map_status_table(&size)) == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    num_entries = __atomic_load_n(&table->num_entries, __ATOMIC_ACQUIRE);
+    max_entries = (size - offsetof(status_table_t, entries)) / sizeof(status_entry_t);
+
+    for (uint32_t i = 0; i < num_entries && i < max_entries; i++) {
+        read_entry(&table->entries[i], &snapshot);
+        if (snapshot.domain[0] != 0) {
+            print_entry(&snapshot);
+        }
+    }
+
+    munmap((void *)table, size);
+    return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    // parse command line
+    const struct option options[] = {
+        { "help",    no_argument, 0, 'h' },
+        { "version", no_argument, 0, 'v' },
+        { 0,         0,           0,  0  },
+    };
+
+    while ((opt = getopt_long(argc, argv, "hv", options, NULL)) != -1) {
+        switch (opt) {
+        case 'h':
+            help();
+            return EXIT_SUCCESS;
+        case 'v':
+            version();
+            return EXIT_SUCCESS;
+        default:
+            syntax();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind + 1 == argc && strcmp(argv[optind], "status") == 0) {
+        return show_status();
+    }
+
+    syntax();
+    return EXIT_FAILURE;
+}
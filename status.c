@@ -0,0 +1,313 @@
+/*
+  Copyright (C) 2017 Christof Efkemann.
+  This file is part of nlddcd.
+
+  nlddcd is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  nlddcd is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with nlddcd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE     // mremap()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "conf.h"
+#include "status.h"
+
+
+static status_table_t *status_table;
+static size_t status_size;
+static int status_fd = -1;
+static unsigned int *free_slots;    // released by removed interfaces
+static unsigned int num_free_slots;
+static bool status_full;            // already reported
+
+
+static size_t table_size(unsigned int max_entries)
+{
+    return offsetof(status_table_t, entries) + max_entries * sizeof(status_entry_t);
+}
+
+
+static bool grow_table(void)
+{
+    unsigned int max_entries = status_table->max_entries * 2;
+    size_t size = table_size(max_entries);
+    unsigned int *slots;
+    void *table;
+
+    if (max_entries > STATUS_MAX_ENTRIES) {
+        return false;
+    }
+
+    slots = realloc(free_slots, max_entries * sizeof *free_slots);
+    if (slots == NULL) {
+        perror("realloc");
+        return false;
+    }
+    free_slots = slots;
+
+    if (ftruncate(status_fd, size) != 0) {
+        perror("ftruncate");
+        return false;
+    }
+
+    table = mremap(status_table, status_size, size, MREMAP_MAYMOVE);
+    if (table == MAP_FAILED) {
+        perror("mremap");
+        return false;
+    }
+    status_table = table;
+    status_size = size;
+
+    __atomic_store_n(&status_table->max_entries, max_entries, __ATOMIC_RELEASE);
+    return true;
+}
+
+
+static void fill_entry(status_entry_t *entry, const interface_status_t *if_stat,
+                       const target_status_t *target, const host_status_t *host)
+{
+    uint32_t flags = 0;
+    const dns_status_t *dns = (host != NULL) ? &host->dns : &target->dns;
+
+    memset(entry->ifname, 0, sizeof entry->ifname);
+    memset(entry->domain, 0, sizeof entry->domain);
+    memset(entry->last_result, 0, sizeof entry->last_result);
+    strncpy(entry->ifname, if_stat->ifname, sizeof entry->ifname - 1);
+
+    if (host != NULL) {
+        // a derived host only has an IPv6 address: the current prefix + iid
+        strncpy(entry->domain, host->domain, sizeof entry->domain - 1);
+        strncpy(entry->last_result, host->last_result, sizeof entry->last_result - 1);
+        memset(&entry->local_ipaddr, 0, sizeof entry->local_ipaddr);
+        memcpy(entry->local_ip6addr.s6_addr, if_stat->local_ip6addr.s6_addr, 8);
+        memcpy(entry->local_ip6addr.s6_addr + 8, host->iid.s6_addr + 8, 8);
+        entry->last_update = host->last_update;
+        flags |= STATUS_HOST;
+        if (if_stat->local_ip6addr_set) {
+            flags |= STATUS_LOCAL_IP6ADDR_SET;
+        }
+    }
+    else {
+        strncpy(entry->domain, target->domain, sizeof entry->domain - 1);
+        strncpy(entry->last_result, target->last_result, sizeof entry->last_result - 1);
+        entry->local_ipaddr = if_stat->local_ipaddr;
+        entry->local_ip6addr = if_stat->local_ip6addr;
+        entry->last_update = target->last_update;
+        if (if_stat->local_ipaddr_set) {
+            flags |= STATUS_LOCAL_IPADDR_SET;
+        }
+        if (if_stat->local_ip6addr_set) {
+            flags |= STATUS_LOCAL_IP6ADDR_SET;
+        }
+    }
+
+    entry->dns_ipaddr = dns->ipaddr;
+    entry->dns_ip6addr = dns->ip6addr;
+    entry->retry_time = target->retry_time;
+
+    if (dns->ipaddr_set) {
+        flags |= STATUS_DNS_IPADDR_SET;
+    }
+    if (dns->ip6addr_set) {
+        flags |= STATUS_DNS_IP6ADDR_SET;
+    }
+    // retries of a target include its derived hosts
+    if (target->retry_time != 0) {
+        flags |= STATUS_RETRY_PENDING;
+    }
+    entry->flags = flags;
+}
+
+
+static void publish_entry(interface_status_t *if_stat, target_status_t *target,
+                          host_status_t *host, unsigned int *slot)
+{
+    status_entry_t *entry;
+    uint32_t seq;
+
+    // assign a table slot on first use, preferring released ones
+    if (*slot == 0 && num_free_slots > 0) {
+        *slot = free_slots[--num_free_slots];
+    }
+    else if (*slot == 0) {
+        if (status_table->num_entries >= status_table->max_entries && !grow_table()) {
+            if (!status_full) {
+                fprintf(stderr, "status table is full, not exporting %s\n",
+                        (host != NULL) ? host->domain : target->domain);
+                status_full = true;
+            }
+            return;
+        }
+        *slot = status_table->num_entries + 1;
+        entry = &status_table->entries[*slot - 1];
+        fill_entry(entry, if_stat, target, host);
+
+        // make the entry visible only after it has been filled in
+        __atomic_store_n(&status_table->num_entries, *slot, __ATOMIC_RELEASE);
+        return;
+    }
+
+    entry = &status_table->entries[*slot - 1];
+    seq = entry->seq;
+
+    __atomic_store_n(&entry->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    fill_entry(entry, if_stat, target, host);
+
+    __atomic_store_n(&entry->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+
+void publish_status(interface_status_t *if_stat)
+{
+    if (status_table == NULL) {
+        return;
+    }
+
+    for (target_status_t *target = if_stat->targets; target != NULL; target = target->next) {
+        publish_entry(if_stat, target, NULL, &target->status_slot);
+
+        for (host_status_t *host = target->hosts; host != NULL; host = host->next) {
+            publish_entry(if_stat, target, host, &host->status_slot);
+        }
+    }
+}
+
+
+static void release_entry(unsigned int *slot)
+{
+    status_entry_t *entry;
+    uint32_t seq;
+
+    if (*slot == 0) {
+        return;
+    }
+
+    entry = &status_table->entries[*slot - 1];
+    seq = entry->seq;
+
+    __atomic_store_n(&entry->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    // readers skip entries without a domain
+    memset((char *)entry + offsetof(status_entry_t, flags), 0,
+           sizeof *entry - offsetof(status_entry_t, flags));
+
+    __atomic_store_n(&entry->seq, seq + 2, __ATOMIC_RELEASE);
+
+    free_slots[num_free_slots++] = *slot;
+    *slot = 0;
+    status_full = false;
+}
+
+
+void unpublish_status(interface_status_t *if_stat)
+{
+    if (status_table == NULL) {
+        return;
+    }
+
+    for (target_status_t *target = if_stat->targets; target != NULL; target = target->next) {
+        release_entry(&target->status_slot);
+
+        for (host_status_t *host = target->hosts; host != NULL; host = host->next) {
+            release_entry(&host->status_slot);
+        }
+    }
+}
+
+
+bool init_status(void)
+{
+    int fd;
+    struct stat st;
+
+    // /dev/shm is world-writable: never reuse an object someone else may
+    // have created (and still holds a writable mapping of), create our own
+    shm_unlink(STATUS_SHM_NAME);
+    fd = shm_open(STATUS_SHM_NAME, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_uid != geteuid()) {
+        fprintf(stderr, "status table is not owned by us\n");
+        close(fd);
+        return false;
+    }
+
+    status_size = table_size(STATUS_MIN_ENTRIES);
+    if (ftruncate(fd, status_size) != 0) {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(STATUS_SHM_NAME);
+        return false;
+    }
+
+    status_table = mmap(NULL, status_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (status_table == MAP_FAILED) {
+        perror("mmap");
+        status_table = NULL;
+        close(fd);
+        shm_unlink(STATUS_SHM_NAME);
+        return false;
+    }
+
+    free_slots = malloc(STATUS_MIN_ENTRIES * sizeof *free_slots);
+    if (free_slots == NULL) {
+        perror("malloc");
+        munmap(status_table, status_size);
+        status_table = NULL;
+        close(fd);
+        shm_unlink(STATUS_SHM_NAME);
+        return false;
+    }
+
+    // kept open to grow the table later on
+    status_fd = fd;
+
+    status_table->version = STATUS_VERSION;
+    status_table->entry_size = sizeof(status_entry_t);
+    status_table->max_entries = STATUS_MIN_ENTRIES;
+
+    // readers check the magic number last
+    __atomic_store_n(&status_table->magic, STATUS_MAGIC, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+
+void cleanup_status(void)
+{
+    if (status_table != NULL) {
+        munmap(status_table, status_size);
+        close(status_fd);
+        shm_unlink(STATUS_SHM_NAME);
+        free(free_slots);
+        status_table = NULL;
+        status_fd = -1;
+        free_slots = NULL;
+        num_free_slots = 0;
+    }
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright (C) 2017 Christof Efkemann.
+  This file is part of nlddcd.
+
+  nlddcd is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  nlddcd is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with nlddcd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _NLDDCD_STATUS_H_
+#define _NLDDCD_STATUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+// shared memory object, i.e. /dev/shm/nlddcd
+#define STATUS_SHM_NAME     "/nlddcd"
+#define STATUS_MAGIC        0x646c6e00  // "\0nld"
+#define STATUS_VERSION      2
+#define STATUS_MIN_ENTRIES  256       // initial size, doubled when full
+#define STATUS_MAX_ENTRIES  65536
+
+#define STATUS_LOCAL_IPADDR_SET   0x01
+#define STATUS_LOCAL_IP6ADDR_SET  0x02
+#define STATUS_DNS_IPADDR_SET     0x04
+#define STATUS_DNS_IP6ADDR_SET    0x08
+#define STATUS_RETRY_PENDING      0x10
+#define STATUS_HOST               0x20  // derived host, IPv6 only
+
+// One entry per update target and per derived host, protected by a seqlock:
+// the daemon increments seq before and after modifying an entry, so readers
+// must retry while seq is odd or has changed during their copy. Entries with
+// an empty domain are unused; their slots are reused for new interfaces.
+// The table grows at runtime, so readers must not access more entries than
+// fit into the size of the object at the time they mapped it.
+typedef struct status_entry {
+    uint32_t seq;
+    uint32_t flags;
+    char ifname[IF_NAMESIZE];
+    char domain[256];
+    struct in_addr  local_ipaddr;
+    struct in_addr  dns_ipaddr;
+    struct in6_addr local_ip6addr;
+    struct in6_addr dns_ip6addr;
+    int64_t last_update;
+    int64_t retry_time;
+    char last_result[16];
+} status_entry_t;
+
+typedef struct status_table {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t max_entries;
+    uint32_t num_entries;
+    uint32_t reserved;
+    status_entry_t entries[];
+} status_table_t;
+
+
+struct interface_status;
+
+bool init_status(void);
+void publish_status(struct interface_status *if_stat);
+void unpublish_status(struct interface_status *if_stat);
+void cleanup_status(void);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+  Copyright (C) 2017 Christof Efkemann.
+  This file is part of nlddcd.
+
+  nlddcd is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  nlddcd is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with nlddcd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <liburing.h>
+
+#include "uring.h"
+
+
+#define URING_ENTRIES      8
+#define URING_BUFFERS      16       // must be a power of 2
+#define URING_BUFFER_SIZE  8192
+#define URING_BUFFER_GROUP 0
+
+
+static struct io_uring ring;
+static struct io_uring_buf_ring *buf_ring;
+static char *buffers;
+static ev_io ring_watcher;
+static int nl_fd = -1;
+static uring_msg_cb_t process_msg;
+static uring_fallback_cb_t fallback;
+
+
+static bool submit_recv(void)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+    if (sqe == NULL) {
+        return false;
+    }
+
+    // one request keeps delivering datagrams until it is terminated
+    io_uring_prep_recv_multishot(sqe, nl_fd, NULL, 0, 0);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+
+    return io_uring_submit(&ring) >= 0;
+}
+
+
+static void ring_cb(EV_P_ ev_io *w, int revents)
+{
+    struct io_uring_cqe *cqe;
+    unsigned int head;
+    unsigned int count = 0;
+    int recycled = 0;
+    bool resubmit = false;
+    bool unsupported = false;
+
+    // process all completions gathered since the last wakeup
+    io_uring_for_each_cqe(&ring, head, cqe) {
+        count++;
+
+        if (cqe->flags & IORING_CQE_F_BUFFER) {
+            unsigned short bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            char *buf = buffers + bid * URING_BUFFER_SIZE;
+
+            if (cqe->res > 0) {
+                process_msg(buf, cqe->res);
+            }
+
+            // hand buffer back to the kernel
+            io_uring_buf_ring_add(buf_ring, buf, URING_BUFFER_SIZE, bid,
+                                  io_uring_buf_ring_mask(URING_BUFFERS), recycled++);
+        }
+        else if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+            unsupported = true;
+        }
+        else if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+            fprintf(stderr, "io_uring recv: %s\n", strerror(-cqe->res));
+        }
+
+        if ((cqe->flags & IORING_CQE_F_MORE) == 0) {
+            resubmit = true;
+        }
+    }
+
+    io_uring_cq_advance(&ring, count);
+    io_uring_buf_ring_advance(buf_ring, recycled);
+
+    if (unsupported) {
+        printf("Multishot receive not supported by kernel, falling back to libev\n");
+        cleanup_uring(EV_A);
+        fallback(EV_A);
+    }
+    else if (resubmit && !submit_recv()) {
+        fprintf(stderr, "io_uring: failed to resubmit receive request\n");
+    }
+}
+
+
+bool init_uring(EV_P_ int fd, uring_msg_cb_t msg_cb, uring_fallback_cb_t fallback_cb)
+{
+    int ret;
+
+    ret = io_uring_queue_init(URING_ENTRIES, &ring, 0);
+    if (ret < 0) {
+        fprintf(stderr, "io_uring_queue_init: %s\n", strerror(-ret));
+        return false;
+    }
+
+    buf_ring = io_uring_setup_buf_ring(&ring, URING_BUFFERS, URING_BUFFER_GROUP, 0, &ret);
+    if (buf_ring == NULL) {
+        fprintf(stderr, "io_uring_setup_buf_ring: %s\n", strerror(-ret));
+        io_uring_queue_exit(&ring);
+        return false;
+    }
+
+    // provide receive buffers
+    buffers = malloc(URING_BUFFERS * URING_BUFFER_SIZE);
+    for (int i = 0; i < URING_BUFFERS; i++) {
+        io_uring_buf_ring_add(buf_ring, buffers + i * URING_BUFFER_SIZE, URING_BUFFER_SIZE, i,
+                              io_uring_buf_ring_mask(URING_BUFFERS), i);
+    }
+    io_uring_buf_ring_advance(buf_ring, URING_BUFFERS);
+
+    nl_fd = fd;
+    process_msg = msg_cb;
+    fallback = fallback_cb;
+
+    if (!submit_recv()) {
+        fprintf(stderr, "io_uring: failed to submit receive request\n");
+        cleanup_uring(EV_A);
+        return false;
+    }
+
+    // the ring becomes readable when completions are pending
+    ev_io_init(&ring_watcher, ring_cb, ring.ring_fd, EV_READ);
+    ev_io_start(EV_A_ &ring_watcher);
+
+    return true;
+}
+
+
+void cleanup_uring(EV_P)
+{
+    if (nl_fd < 0) {
+        return;
+    }
+
+    ev_io_stop(EV_A_ &ring_watcher);
+    io_uring_free_buf_ring(&ring, buf_ring, URING_BUFFERS, URING_BUFFER_GROUP);
+    io_uring_queue_exit(&ring);
+    free(buffers);
+
+    buf_ring = NULL;
+    buffers = NULL;
+    nl_fd = -1;
+}
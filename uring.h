@@ -0,0 +1,33 @@
+/*
+  Copyright (C) 2017 Christof Efkemann.
+  This file is part of nlddcd.
+
+  nlddcd is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  nlddcd is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with nlddcd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _NLDDCD_URING_H_
+#define _NLDDCD_URING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <ev.h>
+
+typedef void (*uring_msg_cb_t)(const void *buf, size_t len);
+typedef void (*uring_fallback_cb_t)(EV_P);
+
+bool init_uring(EV_P_ int fd, uring_msg_cb_t msg_cb, uring_fallback_cb_t fallback_cb);
+void cleanup_uring(EV_P);
+
+#endif